@@ -0,0 +1,166 @@
+/*
+Usage example:
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "ActiveObject.h"
+
+// No thread of its own, its handlers run on the shared normal priority work queue
+static ActiveObject blinker("blinker", ACTIVE_OBJECT_PRIORITY_NORMAL);
+
+static int blinkerInit() {
+  // One handler per event id, each one runs to completion before the next event is handled
+  blinker.on(EVENT_BUTTON_PRESSED, [](const event_t &event) {
+    printk("Button pressed, blinking for 5 seconds\r\n");
+    blinker.schedule(K_SECONDS(5));
+  });
+
+  // The timer of the object ends up on the same work queue, never concurrently with a handler
+  blinker.onTimeout([]() {
+    printk("Done blinking\r\n");
+  });
+
+  return 0;
+}
+
+SYS_INIT(blinkerInit, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+*/
+
+#ifndef ACTIVE_OBJECT_H
+#define ACTIVE_OBJECT_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+
+#include <zephyr/kernel.h>
+
+#include "EventManager.h"
+
+// Shared work queues the active objects run on, each one is a single thread
+typedef enum {
+  ACTIVE_OBJECT_PRIORITY_HIGH = 0,
+  ACTIVE_OBJECT_PRIORITY_NORMAL,
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+  ACTIVE_OBJECT_PRIORITY_TEST,
+#endif
+  ACTIVE_OBJECT_PRIORITY_COUNT,
+} active_object_priority_t;
+
+// Time critical and short handlers only, like sampling (the stack the sampling thread had)
+static constexpr uint32_t ACTIVE_OBJECT_HIGH_STACK_SIZE = 1024;
+static constexpr int ACTIVE_OBJECT_HIGH_THREAD_PRIORITY = 6;
+
+// Everything else, including handlers that block on the network, the HTTP request queue and storage work
+static constexpr uint32_t ACTIVE_OBJECT_NORMAL_STACK_SIZE = 4096;
+static constexpr int ACTIVE_OBJECT_NORMAL_THREAD_PRIORITY = 7;
+
+// Test objects, below everything else so they only measure the bus and never slow the application down
+static constexpr uint32_t ACTIVE_OBJECT_TEST_STACK_SIZE = 1024;
+static constexpr int ACTIVE_OBJECT_TEST_THREAD_PRIORITY = 8;
+
+// Active objects that can exist at the same time
+static constexpr uint32_t ACTIVE_OBJECT_MAX_OBJECTS = 8;
+
+// Events waiting to be handled by one active object, a publisher waits for room when it's full
+static constexpr uint32_t ACTIVE_OBJECT_QUEUE_SIZE = 16;
+
+// What an active object went through since boot, or since the metrics were reset
+typedef struct {
+  uint32_t handled;
+  uint32_t dropped;
+  uint32_t queueHighWater;
+
+  // From publication to the start of the handler, and handler run time
+  event_histogram_t latency;
+  event_histogram_t runTime;
+} active_object_metrics_t;
+
+// Run-to-completion state machine without a thread of its own, as described in docs/design.md.
+// Events published with eventPublish() are copied into the queue of every object that has a
+// handler for them, then handled one at a time on the shared work queue of the object, so each
+// event is handled exactly once, in publication order, unless the publisher gave up waiting.
+class ActiveObject {
+
+public:
+  ActiveObject(const char *name, active_object_priority_t priority);
+  ~ActiveObject();
+
+  // Register handlers before the first event is published, usually from a SYS_INIT function
+  void on(event_id_t id, std::function<void(const event_t &event)> handler);
+  void onTimeout(std::function<void()> handler);
+
+  // Queue an event for this object only, from any thread or ISR (where it never waits)
+  int post(const event_t &event, k_timeout_t timeout = K_NO_WAIT);
+
+  // One-shot timer, scheduling again replaces the pending timeout
+  void schedule(k_timeout_t timeout);
+  void cancel();
+
+  const char *name() const;
+
+  active_object_metrics_t metrics() const;
+  void resetMetrics();
+
+  // Called by eventPublish() for every event accepted by its channel
+  static int dispatch(const event_t &event, k_timeout_t timeout);
+
+  // Every active object, in creation order
+  static uint32_t count();
+  static ActiveObject *at(uint32_t index);
+
+  // Shared work queue of a priority, started on first use, for work that runs alongside the objects
+  static struct k_work_q *queueOf(active_object_priority_t priority);
+
+private:
+  // Work items point back to their object, the object itself isn't standard-layout
+  struct eventWorkItem {
+    struct k_work work;
+    ActiveObject *owner;
+  };
+  struct timerWorkItem {
+    struct k_work_delayable work;
+    ActiveObject *owner;
+  };
+
+  // Events are stamped when queued to measure how long they wait
+  struct queuedEvent {
+    event_t event;
+    uint32_t postedAt;
+  };
+
+  static void eventWorkHandler(struct k_work *work);
+  static void timerWorkHandler(struct k_work *work);
+
+  const char *objectName;
+  struct k_work_q *queue;
+  struct eventWorkItem eventWork;
+  struct timerWorkItem timerWork;
+
+  // Events not handled yet, filled from the publishers context
+  struct k_msgq events;
+  char eventsBuffer[ACTIVE_OBJECT_QUEUE_SIZE * sizeof(struct queuedEvent)] __aligned(4);
+
+  std::function<void(const event_t &event)> handlers[EVENT_MAX_VALUE];
+  std::function<void()> timeoutHandler;
+
+  // Updated by publishers from any context
+  std::atomic<uint32_t> droppedCount;
+  std::atomic<uint32_t> queueHighWater;
+
+  // Updated by the work queue only
+  uint32_t handledCount;
+  event_histogram_t latency;
+  event_histogram_t runTime;
+
+  // Every active object, in creation order
+  static ActiveObject *objects[ACTIVE_OBJECT_MAX_OBJECTS];
+  static uint32_t objectCount;
+
+};
+
+#endif // ACTIVE_OBJECT_H
@@ -0,0 +1,122 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+
+// Zephyr includes
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "BatchRecord.h"
+#include "Storage.h"
+
+static constexpr uint16_t HISTORY_ID = 0x200;
+
+static void saveAndReplaySomething(const sample_t *samples, uint16_t count) {
+  BatchRecord record;
+  sample_t sample = {0};
+
+  // Get the Storage instance
+  Storage& storage = Storage::getInstance();
+
+  // Pack the samples in a single NVS entry, compressed on the way to flash
+  record.begin(42);
+  for (uint16_t index = 0; index < count; index++) {
+    if (!record.append(samples[index])) {
+      break;
+    }
+  }
+  storage.writeBatch(HISTORY_ID, record);
+
+  // Read the entry back, it's rejected if the CRC doesn't match
+  if (storage.readBatch(HISTORY_ID, &record) == 0) {
+    while (record.next(&sample)) {
+      printk("Batch %d: %d at %u ms\r\n", record.sequence(), sample.centiDegrees, sample.uptimeMs);
+    }
+  }
+}
+*/
+
+#ifndef BATCH_RECORD_H
+#define BATCH_RECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "Sample.h"
+
+// Samples packed in a single record, sized so a full record fits comfortably in an NVS sector
+static constexpr uint16_t BATCH_RECORD_MAX_SAMPLES = 16;
+
+// Compress the samples when a record is stored, raw records are still read back
+static constexpr bool BATCH_RECORD_COMPRESSION_ENABLED = true;
+
+// How the samples that follow the header are stored
+typedef enum : uint8_t {
+  BATCH_RECORD_ENCODING_RAW = 0,
+  BATCH_RECORD_ENCODING_DELTA,
+} batch_record_encoding_t;
+
+// Header stored in front of the samples
+typedef struct __attribute__((packed)) {
+  uint32_t sequence;
+  uint8_t count;
+
+  // Records written before compression existed had a 16-bit count, its upper byte reads as RAW
+  uint8_t encoding;
+
+  // CRC-16/CCITT of the sequence, the count, the encoding and the stored samples
+  uint16_t crc;
+} batch_record_header_t;
+
+static_assert(BATCH_RECORD_MAX_SAMPLES <= UINT8_MAX, "The sample count is stored on a byte");
+
+// Several samples stored as one NVS entry, so they share a single allocation table entry
+class BatchRecord {
+
+public:
+  BatchRecord();
+  ~BatchRecord();
+
+  // Filling side
+  void begin(uint32_t sequence);
+  bool append(const sample_t &sample);
+  void seal();
+
+  // Reading side, a cursor over the samples
+  int load(size_t length);
+  void rewind();
+  bool next(sample_t *sample);
+  uint16_t remaining() const;
+
+  uint32_t sequence() const;
+  uint16_t count() const;
+  bool isEmpty() const;
+  bool isFull() const;
+
+  // Raw record, header included
+  void *data();
+  size_t size() const;
+
+  // Stored form of the record, compressed when it's worth it, sealed with a CRC either way
+  size_t encode(uint8_t *buffer, size_t capacity);
+  int decode(const uint8_t *buffer, size_t length);
+  static constexpr size_t capacity() {
+    return sizeof(batch_record_header_t) + (BATCH_RECORD_MAX_SAMPLES * sizeof(sample_t));
+  }
+
+private:
+  uint16_t checksum() const;
+  static uint16_t checksumOf(const batch_record_header_t &header, const uint8_t *payload, size_t length);
+
+  struct __attribute__((packed)) {
+    batch_record_header_t header;
+    sample_t samples[BATCH_RECORD_MAX_SAMPLES];
+  } record;
+  uint16_t cursor;
+
+};
+
+#endif // BATCH_RECORD_H
@@ -0,0 +1,128 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "CoapClient.h"
+
+// Thread handler function declaration
+static void coapThreadHandler();
+
+// Delay value used inside thread loops to yield back to scheduler
+static constexpr int32_t COAP_THREAD_POLL_TIME_MS = 1000;
+
+// Threads definition
+K_THREAD_DEFINE(coapThread, 2048, coapThreadHandler, NULL, NULL, NULL, 7, 0, 0);
+
+static void coapThreadHandler() {
+  // Create a CoAP client as a local object
+  CoapClient client((char *)"10.42.0.1", 5683);
+
+  // Confirmable POST, bodies larger than one block are sent block-wise
+  client.post("data", (const uint8_t *)"{\"pi\":3.14}", sizeof("{\"pi\":3.14}") - 1,
+              [](uint8_t code, const uint8_t *payload, uint16_t length) {
+    printk("Response %d.%02d: %.*s\r\n", code >> 5, code & 0x1F, length, payload);
+  });
+
+  // Get notified every time the resource changes
+  client.observe("config", [](uint8_t code, const uint8_t *payload, uint16_t length) {
+    printk("Notification: %.*s\r\n", length, payload);
+  });
+
+  // Notifications are handled while waiting for incoming packets
+  while (true) {
+    client.process(COAP_THREAD_POLL_TIME_MS);
+  }
+}
+*/
+
+#ifndef COAP_CLIENT_H
+#define COAP_CLIENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <functional>
+
+#include <zephyr/net/net_ip.h>
+#include <zephyr/net/coap.h>
+
+// Largest datagram sent or received
+static constexpr uint32_t COAP_CLIENT_BUFFER_SIZE = 256;
+
+// Block-wise transfer kicks in for bodies larger than one block
+static constexpr enum coap_block_size COAP_CLIENT_BLOCK_SIZE = COAP_BLOCK_64;
+static constexpr uint16_t COAP_CLIENT_BLOCK_BYTES = 1 << (COAP_CLIENT_BLOCK_SIZE + 4);
+
+// Confirmable message retransmission (RFC 7252 section 4.8 defaults)
+static constexpr int32_t COAP_CLIENT_ACK_TIMEOUT_MS = 2000;
+static constexpr uint32_t COAP_CLIENT_MAX_RETRANSMIT = 4;
+
+class CoapClient {
+
+public:
+  CoapClient(char *server, uint16_t port);
+  ~CoapClient();
+
+  int post(const char *path,
+           const uint8_t *data,
+           uint32_t length,
+           std::function<void(uint8_t, const uint8_t *, uint16_t)> callback);
+  int postStream(const char *path,
+                 std::function<int(uint8_t *, uint32_t)> producer,
+                 std::function<void(uint8_t, const uint8_t *, uint16_t)> callback);
+  int observe(const char *path, std::function<void(uint8_t, const uint8_t *, uint16_t)> callback);
+  int cancelObserve();
+  int process(int32_t timeoutMs);
+
+  uint32_t bytesSent() const;
+  uint32_t bytesReceived() const;
+  int64_t lastRoundTripMs() const;
+
+private:
+  int open();
+  int initRequest(struct coap_packet *request, uint8_t type, uint8_t method, uint8_t *token, uint8_t tokenLength);
+  int appendPath(struct coap_packet *request, const char *path);
+  int sendBlock(const char *path,
+                uint32_t number,
+                bool more,
+                const uint8_t *data,
+                uint16_t length,
+                std::function<void(uint8_t, const uint8_t *, uint16_t)> callback);
+  int exchange(struct coap_packet *request, struct coap_packet *response);
+  int receive(struct coap_packet *packet, int32_t timeoutMs);
+  bool dispatchNotification(struct coap_packet *packet);
+  int sendEmpty(uint8_t type, uint16_t id);
+
+  int sock;
+  char *server;
+  uint16_t port;
+  struct sockaddr socketAddress;
+  uint8_t txBuffer[COAP_CLIENT_BUFFER_SIZE];
+  uint8_t rxBuffer[COAP_CLIENT_BUFFER_SIZE];
+
+  // Token of the current request, to match a separate (non piggybacked) response
+  uint8_t token[COAP_TOKEN_MAX_LEN];
+  uint8_t tokenLength;
+
+  // Single observation at a time
+  bool observing;
+  char observePath[32];
+  uint8_t observeToken[COAP_TOKEN_MAX_LEN];
+  uint8_t observeTokenLength;
+  std::function<void(uint8_t, const uint8_t *, uint16_t)> observeCallback;
+
+  // Wire statistics, to compare against the HTTP uplink
+  uint32_t sentBytes;
+  uint32_t receivedBytes;
+  int64_t roundTripMs;
+
+};
+
+#endif // COAP_CLIENT_H
@@ -1,9 +1,16 @@
 #ifndef EVENT_MANAGER_H
 #define EVENT_MANAGER_H
 
+// Lib C includes
+#include <stdint.h>
+
 // Zephyr includes
+#include <zephyr/kernel.h>
 #include <zephyr/zbus/zbus.h>
 
+// Payload of sensor data events, see SampleBlock.h
+class SampleBlock;
+
 // Macro to convert event ID to string
 #define EVENT_ID_TO_STRING(id) (EVENT_NAMES[(id)])
 
@@ -11,30 +18,109 @@
 typedef enum {
   EVENT_INITIAL_VALUE = 0,
   EVENT_NETWORK_AVAILABLE,
+  EVENT_NETWORK_LOST,
   EVENT_BUTTON_PRESSED,
   EVENT_START_SENSOR_DATA_ACQUISITION,
   EVENT_SENSOR_DATA_SAVED,
   EVENT_SENSOR_DATA_SENT,
+  EVENT_STORAGE_READY,
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+  EVENT_BUS_STRESS,
+#endif
   EVENT_MAX_VALUE
 } event_id_t;
 
 // event_id_t enum is embedded inside event_t struct because ZBUS only accepts struct or union
 typedef struct {
   event_id_t id;
+
+  // Sequence number of the sensor data batch the event is about, if any, or of the <EVENT_BUS_STRESS> event
+  uint32_t batch;
+
+  // <EVENT_SENSOR_DATA_SAVED>: the batch itself, or nullptr when its samples went to SensorDataBuffer.
+  // The publisher only guarantees it's alive while observers are called, so only a listener can keep
+  // it, by claiming it. Subscribers read the event later and must not dereference it.
+  SampleBlock *block;
 } event_t;
 
 // Event id to string mapping
 static const char *EVENT_NAMES[] = {
   [EVENT_INITIAL_VALUE]                 = "EVENT_INITIAL_VALUE",
   [EVENT_NETWORK_AVAILABLE]             = "EVENT_NETWORK_AVAILABLE",
+  [EVENT_NETWORK_LOST]                  = "EVENT_NETWORK_LOST",
   [EVENT_BUTTON_PRESSED]                = "EVENT_BUTTON_PRESSED",
   [EVENT_START_SENSOR_DATA_ACQUISITION] = "EVENT_START_SENSOR_DATA_ACQUISITION",
   [EVENT_SENSOR_DATA_SAVED]             = "EVENT_SENSOR_DATA_SAVED",
   [EVENT_SENSOR_DATA_SENT]              = "EVENT_SENSOR_DATA_SENT",
+  [EVENT_STORAGE_READY]                 = "EVENT_STORAGE_READY",
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+  [EVENT_BUS_STRESS]                    = "EVENT_BUS_STRESS",
+#endif
   [EVENT_MAX_VALUE]                     = "EVENT_MAX_VALUE"
 };
 
-// Import channel from the source file
-ZBUS_CHAN_DECLARE(eventsChannel);
+// Events are split by topic so observers only wake up for the ones they care about
+typedef enum {
+  EVENT_CHANNEL_CONNECTIVITY = 0,
+  EVENT_CHANNEL_CONTROL,
+  EVENT_CHANNEL_ACQUISITION,
+  EVENT_CHANNEL_UPLOAD,
+  EVENT_CHANNEL_COUNT
+} event_channel_t;
+
+// Event id to channel mapping, the channel validators reject events published anywhere else
+static const event_channel_t EVENT_CHANNELS[] = {
+  [EVENT_INITIAL_VALUE]                 = EVENT_CHANNEL_COUNT,
+  [EVENT_NETWORK_AVAILABLE]             = EVENT_CHANNEL_CONNECTIVITY,
+  [EVENT_NETWORK_LOST]                  = EVENT_CHANNEL_CONNECTIVITY,
+  [EVENT_BUTTON_PRESSED]                = EVENT_CHANNEL_CONTROL,
+  [EVENT_START_SENSOR_DATA_ACQUISITION] = EVENT_CHANNEL_CONTROL,
+  [EVENT_SENSOR_DATA_SAVED]             = EVENT_CHANNEL_ACQUISITION,
+  [EVENT_SENSOR_DATA_SENT]              = EVENT_CHANNEL_UPLOAD,
+  [EVENT_STORAGE_READY]                 = EVENT_CHANNEL_CONTROL,
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+  [EVENT_BUS_STRESS]                    = EVENT_CHANNEL_CONTROL,
+#endif
+  [EVENT_MAX_VALUE]                     = EVENT_CHANNEL_COUNT
+};
+
+// Import channels from the source file
+ZBUS_CHAN_DECLARE(connectivityChannel, controlChannel, acquisitionChannel, uploadChannel);
+
+// Duration histogram with buckets growing 4 times each: under 16 us, 64 us, 256 us, 1 ms, 4 ms, 16 ms, 64 ms, and above
+static constexpr uint32_t EVENT_HISTOGRAM_BUCKETS = 8;
+static constexpr uint32_t EVENT_HISTOGRAM_FIRST_BUCKET_US = 16;
+
+typedef struct {
+  uint32_t buckets[EVENT_HISTOGRAM_BUCKETS];
+  uint32_t maxUs;
+} event_histogram_t;
+
+// Publication counters of one event id
+typedef struct {
+  uint32_t published;
+  uint32_t failed;
+} event_counters_t;
+
+// Metrics summary logged periodically when not 0, like telemetry
+static constexpr int32_t EVENT_METRICS_REPORT_PERIOD_MS = 0;
+
+// How long a publisher waits for room in a full active object queue before the event is lost
+static constexpr uint32_t EVENT_PUBLISH_TIMEOUT_MS = 100;
+
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+// Events sent by "events stress" when no count is given
+static constexpr uint32_t EVENT_STRESS_DEFAULT_COUNT = 1000;
+#endif
+
+// Publish an event on the channel of its id, queue it for every active object handling it, and count the
+// outcome per event id. Returns -ENOBUFS when at least one active object couldn't take it in time.
+int eventPublish(const event_t &event, k_timeout_t timeout);
+
+// The channel an event id is published on, nullptr for ids that are never published
+const struct zbus_channel *eventChannel(event_id_t id);
+
+event_counters_t eventCounters(event_id_t id);
+void eventHistogramAdd(event_histogram_t *histogram, uint32_t durationUs);
 
 #endif // EVENT_MANAGER_H
\ No newline at end of file
@@ -22,20 +22,30 @@ static constexpr uint32_t HTTP_CLIENT_THREAD_SLEEP_TIME_MS = 100;
 K_THREAD_DEFINE(httpGetRequestThread, 1024, httpGetRequestThreadHandler, NULL, NULL, NULL, 7, 0, 0);
 
 static void httpGetRequestThreadHandler() {
-  // Create an HTTP client as a local object
-  HttpClient client((char *)"10.42.0.1", 1880);
-
-  // Send GET request and handle response in a lambda callback
-  client.get("/data", [](uint8_t *response, uint32_t length) {
-    uint32_t index = 0;
-
-    // Skip headers by looking for the start of the json message
-    for (index = 0; index < length; index++) {
-      if (response[index] == '{') {
-        break;
-      }
+  // Create an HTTP client as a local object, keeping its connection open between requests
+  HttpClient client((char *)"10.42.0.1", 1880, true);
+
+  // Send GET request and handle response in a lambda callback, called with every body slice
+  // as it arrives (pointing into the receive buffer) then once with an empty slice at the end
+  client.get("/data", [](const HttpResponse &response, const uint8_t *body, uint32_t length) {
+    if (length > 0) {
+      printk("%.*s", length, body);
+    } else {
+      printk("\r\nStatus %d (%d bytes announced)\r\n", response.status(), (int)response.contentLength());
+    }
+  });
+
+  // Stream a body of any size, the producer fills at most `size` bytes per call and returns 0 when done
+  uint32_t counter = 0;
+  client.postStream("/data", [&counter](uint8_t *buffer, uint32_t size) -> int {
+    if (counter >= 100) {
+      return 0;
+    }
+    return snprintf((char *)buffer, size, "%u\n", counter++);
+  }, [](const HttpResponse &response, const uint8_t *body, uint32_t length) {
+    if (length == 0) {
+      printk("\r\nStatus %d\r\n", response.status());
     }
-    printk("\r\nResponse(%d bytes): %.*s\r\n", length-index, length-index, &response[index]);
   });
 
   while (true) {
@@ -51,26 +61,72 @@ static void httpGetRequestThreadHandler() {
 #include <functional>
 
 #include <zephyr/net/net_ip.h>
+#include <zephyr/net/http/client.h>
+
+#include "EventManager.h"
+#include "HttpResponse.h"
 
 static constexpr uint32_t HTTP_CLIENT_RESPONSE_BUFFER_SIZE = 512;
 
+// Largest chunk pulled from a body producer and sent in one Transfer-Encoding: chunked frame
+static constexpr uint32_t HTTP_CLIENT_CHUNK_SIZE = 128;
+
+// Room for the "<hex size>\r\n" prefix, the chunk data and the trailing "\r\n"
+static constexpr uint32_t HTTP_CLIENT_CHUNK_PREFIX_SIZE = sizeof("ffffffff\r\n") - 1;
+static constexpr uint32_t HTTP_CLIENT_CHUNK_FRAME_SIZE = HTTP_CLIENT_CHUNK_PREFIX_SIZE + HTTP_CLIENT_CHUNK_SIZE + 2;
+
 class HttpClient {
 
+  // The request queue frames the chunks of streamed bodies the same way
+  friend class HttpRequestQueue;
+
 public:
-  std::function<void(uint8_t *, uint32_t)> callback;
+  HttpResponse response;
 
-  HttpClient(char *server, uint16_t port);
+  HttpClient(char *server, uint16_t port, bool keepAlive = false);
   ~HttpClient();
-  int get(const char *endpoint, std::function<void(uint8_t *, uint32_t)> callback);
+  int get(const char *endpoint, std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback);
   int post(const char *endpoint,
            const char *data,
            uint32_t length,
-           std::function<void(uint8_t *, uint32_t)> callback);
+           std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback);
+  int postStream(const char *endpoint,
+                 std::function<int(uint8_t *, uint32_t)> producer,
+                 std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback);
+  int getAsync(const char *endpoint,
+               std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback,
+               event_id_t completionEvent = EVENT_INITIAL_VALUE);
+  int postAsync(const char *endpoint,
+                const char *data,
+                uint32_t length,
+                std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback,
+                event_id_t completionEvent = EVENT_INITIAL_VALUE);
+  int postStreamAsync(const char *endpoint,
+                      std::function<int(uint8_t *, uint32_t)> producer,
+                      std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback,
+                      event_id_t completionEvent = EVENT_INITIAL_VALUE);
 
 private:
+  static int frameChunk(uint8_t *frame,
+                        const std::function<int(uint8_t *, uint32_t)> &producer,
+                        uint8_t **start,
+                        bool *last);
+  static int payloadCallback(int sock, struct http_request *request, void *userData);
+  int sendChunks(int sock);
+  int request(enum http_method method,
+              const char *endpoint,
+              const char *data,
+              uint32_t length,
+              std::function<int(uint8_t *, uint32_t)> producer,
+              std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback);
+  int execute(int sock, struct http_request *request);
+
   int sock;
   char *server;
   uint16_t port;
+  bool keepAlive;
+  std::function<int(uint8_t *, uint32_t)> producer;
+  bool bodyStarted;
   struct sockaddr socketAddress;
   uint8_t httpResponseBuffer[HTTP_CLIENT_RESPONSE_BUFFER_SIZE];
 
@@ -0,0 +1,88 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdbool.h>
+
+// Zephyr includes
+#include <zephyr/net/socket.h>
+
+// User C++ class headers
+#include "HttpConnectionPool.h"
+
+static void sendSomething(const struct sockaddr *serverAddress) {
+  bool reused = false;
+
+  // Get the singleton instance of the connection pool
+  HttpConnectionPool& pool = HttpConnectionPool::getInstance();
+
+  // Get a connected socket, either a kept-alive one or a freshly connected one
+  int sock = pool.acquire(serverAddress, &reused);
+  if (sock < 0) {
+    return;
+  }
+
+  // ... use the socket ...
+
+  // Hand the socket back, it stays open for the next request to the same server
+  pool.release(sock, true);
+}
+*/
+
+#ifndef HTTP_CONNECTION_POOL_H
+#define HTTP_CONNECTION_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_ip.h>
+
+// Maximum number of idle keep-alive sockets kept open at the same time
+static constexpr uint32_t HTTP_CONNECTION_POOL_SIZE = 2;
+
+// An idle socket older than this is closed instead of being reused
+static constexpr int64_t HTTP_CONNECTION_IDLE_TIMEOUT_MS = 30000;
+
+class HttpConnectionPool {
+public:
+  // Static method to access the singleton instance
+  static HttpConnectionPool& getInstance();
+
+  int acquire(const struct sockaddr *address, bool *reused);
+  void release(int sock, bool reusable);
+
+  // Non-blocking halves of acquire(), for callers that connect sockets themselves:
+  // a live idle socket to <address> or -ENOENT, and a freshly created socket to pool on release
+  int acquireIdle(const struct sockaddr *address);
+  void adopt(int sock, const struct sockaddr *address);
+
+private:
+  // Private constructor and destructor to prevent direct instantiation and destruction
+  HttpConnectionPool();
+  ~HttpConnectionPool();
+
+  // One pooled socket and the server (address + port) it is connected to
+  struct connection {
+    int sock;
+    bool inUse;
+    int64_t lastUsed;
+    struct sockaddr address;
+  };
+
+  static int connectTo(const struct sockaddr *address);
+  static bool isAlive(int sock);
+  void expireIdleConnections();
+
+  // Called with <mutex> held
+  int takeIdle(const struct sockaddr *address);
+  struct connection *reserveSlot(const struct sockaddr *address);
+
+  // Static member to hold the singleton instance
+  static HttpConnectionPool instance;
+
+  struct k_mutex mutex;
+  struct connection connections[HTTP_CONNECTION_POOL_SIZE];
+};
+
+#endif // HTTP_CONNECTION_POOL_H
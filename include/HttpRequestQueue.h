@@ -0,0 +1,149 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+
+// Zephyr includes
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "HttpClient.h"
+
+static void sendSomethingWithoutBlocking() {
+  // The client only describes the server, requests are handed over to the queue
+  static HttpClient client((char *)"10.42.0.1", 1880);
+
+  // Returns as soon as the request is queued, the normal priority work queue does the rest
+  client.postAsync("/data", "{\"pi\":3.14}", sizeof("{\"pi\":3.14}") - 1,
+                   [](const HttpResponse &response, const uint8_t *body, uint32_t length) {
+    // Runs on the normal priority work queue for every body slice, then once more when the request is over
+    if ((length == 0) && (response.error() == 0)) {
+      printk("Status %d\r\n", response.status());
+    }
+  });
+}
+*/
+
+#ifndef HTTP_REQUEST_QUEUE_H
+#define HTTP_REQUEST_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <functional>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_ip.h>
+#include <zephyr/net/http/parser.h>
+
+#include "EventManager.h"
+#include "HttpClient.h"
+#include "HttpResponse.h"
+
+// Number of requests that can be queued or in flight at the same time
+static constexpr uint32_t HTTP_REQUEST_QUEUE_SIZE = 4;
+
+// Sockets driven together, bounded by what a single poll() accepts
+static constexpr uint32_t HTTP_REQUEST_QUEUE_MAX_IN_FLIGHT =
+  (HTTP_REQUEST_QUEUE_SIZE < CONFIG_NET_SOCKETS_POLL_MAX) ? HTTP_REQUEST_QUEUE_SIZE : CONFIG_NET_SOCKETS_POLL_MAX;
+
+// Request line and headers, and the body copied at enqueue time (also used to stage chunk frames)
+static constexpr uint32_t HTTP_REQUEST_QUEUE_HEADER_SIZE = 128;
+static constexpr uint32_t HTTP_REQUEST_QUEUE_PAYLOAD_SIZE = 256;
+
+// A request that didn't complete within this time is failed with -ETIMEDOUT
+static constexpr int64_t HTTP_REQUEST_QUEUE_TIMEOUT_MS = 5000;
+
+// How often the sockets in flight are polled again while none of them is ready
+static constexpr int32_t HTTP_REQUEST_QUEUE_POLL_INTERVAL_MS = 10;
+
+class HttpRequestQueue {
+public:
+  // Static method to access the singleton instance
+  static HttpRequestQueue& getInstance();
+
+  int enqueue(const struct sockaddr *address,
+              const char *host,
+              enum http_method method,
+              const char *endpoint,
+              const char *data,
+              uint32_t length,
+              std::function<int(uint8_t *, uint32_t)> producer,
+              std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback,
+              event_id_t completionEvent,
+              bool keepAlive);
+
+private:
+  // Private constructor and destructor to prevent direct instantiation and destruction
+  HttpRequestQueue();
+  ~HttpRequestQueue();
+
+  enum state {
+    STATE_FREE = 0,
+    STATE_QUEUED,
+    STATE_CONNECTING,
+    STATE_SENDING,
+    STATE_RECEIVING,
+  };
+
+  enum txStage {
+    TX_HEADER = 0,
+    TX_BODY,
+    TX_DONE,
+  };
+
+  struct request {
+    enum state state;
+    uint32_t order;
+    int sock;
+    int64_t deadline;
+    struct sockaddr address;
+
+    // Sockets of keep-alive requests come from and go back to HttpConnectionPool. A reused one the server
+    // dropped meanwhile is replaced once, as long as no byte of the request was sent on it.
+    bool keepAlive;
+    bool reused;
+    bool retried;
+    bool replayable;
+
+    // Transmit side
+    char header[HTTP_REQUEST_QUEUE_HEADER_SIZE];
+    uint32_t headerLength;
+    uint8_t payload[HTTP_REQUEST_QUEUE_PAYLOAD_SIZE];
+    uint32_t payloadLength;
+    std::function<int(uint8_t *, uint32_t)> producer;
+    enum txStage txStage;
+    uint8_t *tx;
+    uint32_t txLength;
+    uint32_t txSent;
+
+    // Receive side, the buffer is reused for every fragment so any response size fits
+    HttpResponse response;
+    uint8_t rxBuffer[HTTP_CLIENT_RESPONSE_BUFFER_SIZE];
+
+    // Completion notification
+    std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback;
+    event_id_t completionEvent;
+  };
+
+  // One non-blocking pass over the requests, run from the normal priority work queue as long as any is in flight
+  static void pollWorkHandler(struct k_work *work);
+  void advance();
+
+  void start(struct request *request);
+  bool retryStale(struct request *request, int result);
+  void onWritable(struct request *request);
+  void onReadable(struct request *request);
+  int nextTxBuffer(struct request *request);
+  void finish(struct request *request, int result);
+
+  // Static member to hold the singleton instance
+  static HttpRequestQueue instance;
+
+  struct k_mutex mutex;
+  struct k_work_delayable pollWork;
+  uint32_t order;
+  struct request requests[HTTP_REQUEST_QUEUE_SIZE];
+};
+
+#endif // HTTP_REQUEST_QUEUE_H
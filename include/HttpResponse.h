@@ -0,0 +1,109 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+
+// Zephyr includes
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "HttpResponse.h"
+
+static void parseSomething(const uint8_t *fragment1, uint32_t length1,
+                           const uint8_t *fragment2, uint32_t length2) {
+  HttpResponse response;
+
+  // Body slices point straight into the fragments being fed, nothing is copied
+  response.begin([](const HttpResponse &response, const uint8_t *body, uint32_t length) {
+    if (length > 0) {
+      printk("%.*s", length, body);
+    } else if (response.isComplete()) {
+      printk("\r\nStatus %d, type %s\r\n", response.status(), response.header("Content-Type"));
+    }
+  });
+
+  // Feed the raw bytes as they come off the socket, in any split
+  response.feed(fragment1, length1);
+  response.feed(fragment2, length2);
+
+  // The connection was closed
+  response.finish();
+}
+*/
+
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <functional>
+
+#include <zephyr/net/http/parser.h>
+
+// Headers are the only part that gets copied, into a bounded name/value table
+static constexpr uint32_t HTTP_RESPONSE_MAX_HEADERS = 8;
+static constexpr uint32_t HTTP_RESPONSE_HEADERS_SIZE = 192;
+
+class HttpResponse {
+
+public:
+  HttpResponse();
+  ~HttpResponse();
+
+  void begin(std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback);
+  int feed(const uint8_t *data, uint32_t length);
+  void finish();
+  void fail(int error);
+
+  uint16_t status() const;
+  int64_t contentLength() const;
+  bool isChunked() const;
+  bool isComplete() const;
+  bool keepAlive() const;
+  int error() const;
+  const char *header(const char *name) const;
+
+  // Bytes on the wire for this exchange, the request side is counted by whoever sends it
+  void addSent(uint32_t length);
+  uint32_t bytesSent() const;
+  uint32_t bytesReceived() const;
+
+private:
+  enum headerState {
+    HEADER_NONE = 0,
+    HEADER_FIELD,
+    HEADER_VALUE,
+    HEADER_SKIP,
+  };
+
+  void end();
+  bool append(const char *data, size_t length);
+  static int onHeaderField(struct http_parser *parser, const char *at, size_t length);
+  static int onHeaderValue(struct http_parser *parser, const char *at, size_t length);
+  static int onHeadersComplete(struct http_parser *parser);
+  static int onBody(struct http_parser *parser, const char *at, size_t length);
+  static int onMessageComplete(struct http_parser *parser);
+
+  static const struct http_parser_settings settings;
+
+  std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback;
+  struct http_parser parser;
+  bool headersComplete;
+  bool complete;
+  bool ended;
+  int lastError;
+  uint32_t sentBytes;
+  uint32_t receivedBytes;
+
+  // Header table: "name\0value\0" pairs stored back to back
+  enum headerState headerState;
+  char headers[HTTP_RESPONSE_HEADERS_SIZE];
+  uint32_t headersLength;
+  uint16_t headerNames[HTTP_RESPONSE_MAX_HEADERS];
+  uint16_t headerValues[HTTP_RESPONSE_MAX_HEADERS];
+  uint32_t headerCount;
+
+};
+
+#endif // HTTP_RESPONSE_H
@@ -33,6 +33,11 @@ static void networkThreadHandler() {
   network.start();
 
   while (true) {
+    // Blocks while the link is down or the address is being negotiated
+    if (network.waitUntilReady(K_SECONDS(10)) < 0) {
+      printk("Network still not ready (%s)\r\n", NETWORK_STATE_TO_STRING(network.state()));
+      continue;
+    }
     k_msleep(NETWORK_THREAD_SLEEP_TIME_MS);
   }
 }
@@ -43,9 +48,63 @@ static void networkThreadHandler() {
 
 #include <stdint.h>
 #include <functional>
+#include <zephyr/kernel.h>
 #include <zephyr/net/net_if.h>
 #include <zephyr/net/net_mgmt.h>
 
+// Macro to convert network state to string
+#define NETWORK_STATE_TO_STRING(state) (NETWORK_STATE_NAMES[(state)])
+
+// Connectivity states, only NETWORK_STATE_READY can carry traffic
+typedef enum {
+  NETWORK_STATE_IDLE = 0,   // start() not called yet
+  NETWORK_STATE_LINK_DOWN,  // No carrier, or the interface is down
+  NETWORK_STATE_CONNECTING, // Link up, waiting for an IPv4 address
+  NETWORK_STATE_READY,      // Link up with an IPv4 address
+} network_state_t;
+
+// Network state to string mapping
+static const char *NETWORK_STATE_NAMES[] = {
+  [NETWORK_STATE_IDLE]       = "NETWORK_STATE_IDLE",
+  [NETWORK_STATE_LINK_DOWN]  = "NETWORK_STATE_LINK_DOWN",
+  [NETWORK_STATE_CONNECTING] = "NETWORK_STATE_CONNECTING",
+  [NETWORK_STATE_READY]      = "NETWORK_STATE_READY"
+};
+
+// Storage id of the last DHCP lease, reused at boot so uploads don't wait for a full DHCP exchange
+static constexpr uint16_t NETWORK_LEASE_ID = 0x0F0;
+static constexpr bool NETWORK_LEASE_CACHE_ENABLED = true;
+
+// How long start() waits for the storage to mount before giving up on the saved lease
+static constexpr int32_t NETWORK_LEASE_STORAGE_TIMEOUT_MS = 500;
+
+// The saved address is dropped if DHCP hasn't confirmed it by then, DHCP goes on from scratch
+static constexpr int32_t NETWORK_LEASE_CONFIRM_TIMEOUT_MS = 30000;
+
+// How often the time spent on the lease is saved, a lease used up before the reset isn't reused
+static constexpr uint32_t NETWORK_LEASE_SAVE_PERIOD_S = 600;
+
+// ARP probes (RFC 5227) sent for the saved address before it is used, and how long to listen for an owner
+static constexpr uint8_t NETWORK_LEASE_PROBE_COUNT = 3;
+static constexpr int32_t NETWORK_LEASE_PROBE_INTERVAL_MS = 300;
+static constexpr int32_t NETWORK_LEASE_PROBE_WAIT_MS = 1000;
+
+// Bumped whenever network_lease_t changes, older records are ignored
+static constexpr uint32_t NETWORK_LEASE_VERSION = 2;
+
+// Last DHCP lease as stored
+typedef struct {
+  uint32_t version;
+  struct in_addr address;
+  struct in_addr netmask;
+  struct in_addr gateway;
+  struct in_addr server;
+  uint32_t leaseTimeS;
+  uint32_t usedS;
+} network_lease_t;
+
+// Follows link and address events, publishes <EVENT_NETWORK_AVAILABLE> when it becomes ready and
+// <EVENT_NETWORK_LOST> when it stops being ready, whatever the reason
 class Network {
 public:
   std::function<void(const char *)> callback;
@@ -56,15 +115,59 @@ public:
   void start();
   void onGotIP(std::function<void(const char *)> callback);
 
+  network_state_t state() const;
+  bool isReady() const;
+
+  // Returns 0 once the network is ready, -EAGAIN on timeout
+  int waitUntilReady(k_timeout_t timeout);
+
 private:
   // Private constructor to prevent direct instantiation
   Network();
   ~Network();
 
+  static void netMgmtCallback(struct net_mgmt_event_callback *cb, uint32_t event, struct net_if *iface);
+
+  // Works the state out from the interface again, publishes the transition if there's one
+  void update();
+
+  // Applies the saved lease until DHCP confirms it, and saves every new lease
+  void restoreLease();
+  void leaseBound();
+  static void provisionalWorkHandler(struct k_work *work);
+  static void leaseSaveWorkHandler(struct k_work *work);
+
+  // The saved address is only applied once nobody answered the ARP probes for it
+  static void probeWorkHandler(struct k_work *work);
+  int sendProbe();
+  bool probeConflict();
+  void stopProbe();
+
   // Static member to hold the singleton instance
   static Network instance;
-  struct net_mgmt_event_callback _mgmtEventCb;
+
+  // Interface and IPv4 events belong to different layers, so they need a callback each
+  struct net_mgmt_event_callback _ifaceEventCb;
+  struct net_mgmt_event_callback _ipv4EventCb;
   struct net_if *_netIface;
+
+  // Changed from the net_mgmt thread and from start() under the mutex, readable from anywhere
+  struct k_mutex _stateLock;
+  struct k_event _stateEvents;
+  volatile network_state_t _state;
+  bool _started;
+
+  // Lease last saved, and whether its address is being probed or in use without DHCP having confirmed it yet
+  network_lease_t _lease;
+  int64_t _leaseBoundMs;
+  bool _provisional;
+  struct k_work_delayable _provisionalWork;
+  struct k_work_delayable _leaseSaveWork;
+
+  // Packet socket the probes go through, only open while probing
+  int _probeSocket;
+  uint8_t _probesSent;
+  struct k_work_delayable _probeWork;
 };
 
 #endif // NETWORK_H
@@ -0,0 +1,69 @@
+/*
+Usage example:
+
+// Zephyr includes
+#include <zephyr/storage/flash_map.h>
+
+// User C++ class headers
+#include "NvsStorageBackend.h"
+
+// NVS over 4 sectors of a scratch partition, on native_sim it lives in the flash simulator
+// which can be backed by a file with --flash=<file>
+static NvsStorageBackend scratch(FIXED_PARTITION_DEVICE(scratch_partition),
+                                 FIXED_PARTITION_OFFSET(scratch_partition),
+                                 4);
+
+static void useSomething() {
+  uint32_t counter = 0;
+
+  if (scratch.mount() == 0) {
+    scratch.read(1, &counter, sizeof(counter));
+    counter++;
+    scratch.write(1, &counter, sizeof(counter));
+  }
+}
+*/
+
+#ifndef NVS_STORAGE_BACKEND_H
+#define NVS_STORAGE_BACKEND_H
+
+#include <stdint.h>
+
+#include <zephyr/device.h>
+#include <zephyr/fs/nvs.h>
+
+#include "StorageBackend.h"
+
+// NVS file system on any flash device: the board flash or the native_sim flash simulator
+class NvsStorageBackend : public StorageBackend {
+public:
+  NvsStorageBackend(const struct device *device, off_t offset, uint16_t sectorCount);
+  ~NvsStorageBackend();
+
+  const char *name() const override;
+  int mount() override;
+  ssize_t read(uint16_t id, void *buffer, size_t length) override;
+  ssize_t write(uint16_t id, const void *data, size_t length) override;
+  int remove(uint16_t id) override;
+  int clear() override;
+  ssize_t freeSpace() override;
+  storage_backend_stats_t stats() const override;
+  void resetStats() override;
+
+  // Sector count used by the next mount, mostly for benchmarks
+  void setSectorCount(uint16_t sectorCount);
+
+private:
+  uint16_t currentSector() const;
+  void countGc(uint16_t sectorBefore, uint32_t startCycles);
+
+  const struct device *device;
+  off_t offset;
+  uint16_t sectorCount;
+  bool mounted;
+
+  struct nvs_fs fs;
+  storage_backend_stats_t counters;
+};
+
+#endif // NVS_STORAGE_BACKEND_H
@@ -0,0 +1,71 @@
+/*
+Usage example:
+
+// Zephyr includes
+#include <zephyr/sys/util.h>
+
+// User C++ class headers
+#include "RamStorageBackend.h"
+
+// The caller provides the entries, sized for the ids it is going to use
+static ram_storage_entry_t scratchEntries[4];
+static RamStorageBackend scratch(scratchEntries, ARRAY_SIZE(scratchEntries));
+
+static void useSomething() {
+  uint32_t counter = 0;
+
+  // Nothing survives a reset, but nothing wears out either
+  scratch.mount();
+  scratch.read(1, &counter, sizeof(counter));
+  counter++;
+  scratch.write(1, &counter, sizeof(counter));
+}
+*/
+
+#ifndef RAM_STORAGE_BACKEND_H
+#define RAM_STORAGE_BACKEND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <zephyr/kernel.h>
+
+#include "StorageBackend.h"
+
+// Largest entry the RAM backend can hold
+static constexpr uint32_t RAM_STORAGE_BACKEND_ENTRY_SIZE = 128;
+
+// One stored id, arrays of these are provided by the owner of the backend
+typedef struct {
+  bool valid;
+  uint16_t id;
+  uint16_t length;
+  uint8_t data[RAM_STORAGE_BACKEND_ENTRY_SIZE];
+} ram_storage_entry_t;
+
+// Entries kept in RAM, a baseline to compare flash backends against and a stand-in when there's no flash
+class RamStorageBackend : public StorageBackend {
+public:
+  RamStorageBackend(ram_storage_entry_t *entries, uint32_t entryCount);
+  ~RamStorageBackend();
+
+  const char *name() const override;
+  int mount() override;
+  ssize_t read(uint16_t id, void *buffer, size_t length) override;
+  ssize_t write(uint16_t id, const void *data, size_t length) override;
+  int remove(uint16_t id) override;
+  int clear() override;
+  ssize_t freeSpace() override;
+  storage_backend_stats_t stats() const override;
+  void resetStats() override;
+
+private:
+  ram_storage_entry_t *find(uint16_t id);
+
+  struct k_mutex mutex;
+  ram_storage_entry_t *entries;
+  uint32_t entryCount;
+  storage_backend_stats_t counters;
+};
+
+#endif // RAM_STORAGE_BACKEND_H
@@ -0,0 +1,23 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdint.h>
+
+// Status flags of a sample, SAMPLE_STATUS_OK means the value can be trusted
+static constexpr uint8_t SAMPLE_STATUS_OK = 0;
+static constexpr uint8_t SAMPLE_STATUS_READ_ERROR = (1 << 0);
+static constexpr uint8_t SAMPLE_STATUS_OUT_OF_RANGE = (1 << 1);
+
+// One temperature reading, kept in fixed-point from the sensor up to the uplink where it's formatted as text
+typedef struct __attribute__((packed)) {
+  // Hundredths of a degree Celsius, -327.68 °C to 327.67 °C
+  int16_t centiDegrees;
+
+  // Uptime the reading was taken at, wraps after about 49 days
+  uint32_t uptimeMs;
+
+  // SAMPLE_STATUS_* flags
+  uint8_t status;
+} sample_t;
+
+#endif // SAMPLE_H
@@ -0,0 +1,87 @@
+/*
+Usage example:
+
+// Zephyr includes
+#include <zephyr/zbus/zbus.h>
+
+// User C++ class headers
+#include "EventManager.h"
+#include "SampleBlock.h"
+
+// Producer: fill a block and publish it, whoever wants it takes a reference from a listener
+static void publishSomething(const sample_t *samples, uint32_t count) {
+  SampleBlock *block = SampleBlock::allocate(42);
+  if (block == nullptr) {
+    return;
+  }
+
+  for (uint32_t index = 0; index < count; index++) {
+    block->append(samples[index]);
+  }
+
+  event_t event = {.id = EVENT_SENSOR_DATA_SAVED, .batch = 42, .block = block};
+  eventPublish(event, K_NO_WAIT);
+
+  // Drop the producer reference, the block goes back to the pool once the last holder is done
+  block->release();
+}
+
+// Listener callback on <acquisitionChannel>, runs in the publisher thread so the block is still alive
+static void somethingListenerCallback(const struct zbus_channel *channel) {
+  const event_t *event = (const event_t *)zbus_chan_const_msg(channel);
+
+  if ((event->id == EVENT_SENSOR_DATA_SAVED) && (event->block != nullptr)) {
+    event->block->claim();
+    // ... hand it over to a thread, which calls release() when it's done ...
+  }
+}
+*/
+
+#ifndef SAMPLE_BLOCK_H
+#define SAMPLE_BLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <atomic>
+
+#include "Sample.h"
+#include "SensorDataBuffer.h"
+
+// Blocks in the pool: one being filled, the ones queued for upload and the ones in flight
+static constexpr uint32_t SAMPLE_BLOCK_POOL_SIZE = 6;
+
+// A batch of samples in a fixed-size pool, passed around by pointer and freed with its last reference
+class SampleBlock {
+
+public:
+  // Returns nullptr when the pool is empty, the caller holds the only reference
+  static SampleBlock *allocate(uint32_t sequence);
+
+  void retain();
+  void release();
+
+  // Taken by a listener: one more reference, and the publisher learns the block found a taker
+  void claim();
+  bool claimed() const;
+
+  bool append(const sample_t &sample);
+  bool isFull() const;
+
+  // The samples, laid out like any other batch so uploads don't care where a batch comes from
+  const sensor_data_batch_t &batch() const;
+
+  // Statistics
+  static uint32_t available();
+  static uint32_t exhausted();
+
+private:
+  SampleBlock(uint32_t sequence);
+  ~SampleBlock();
+
+  std::atomic<uint32_t> references;
+  bool taken;
+  sensor_data_batch_t samples;
+
+};
+
+#endif // SAMPLE_BLOCK_H
@@ -0,0 +1,84 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+
+// Zephyr includes
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "SampleCodec.h"
+
+static void packSomething(const sample_t *samples, uint16_t count) {
+  SampleCodec codec;
+  uint8_t packed[64] = {0};
+  sample_t sample = {0};
+
+  // Samples go in one by one until the buffer is full
+  codec.beginEncode(packed, sizeof(packed));
+  for (uint16_t index = 0; index < count; index++) {
+    if (!codec.encode(samples[index])) {
+      break;
+    }
+  }
+  printk("%d samples in %d bytes\r\n", count, codec.encodedSize());
+
+  // And come out in the same order, the decoder has to be told how many there are
+  codec.beginDecode(packed, codec.encodedSize());
+  for (uint16_t index = 0; index < count; index++) {
+    codec.decode(&sample);
+  }
+}
+*/
+
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "Sample.h"
+
+// Streaming compressor for a series of samples, in the spirit of Gorilla: the first sample is stored
+// as is, then timestamps are stored as delta-of-delta and values as deltas, both zigzag encoded in
+// variable length bit fields, and the status only when it changes. A steady series at a fixed period
+// takes about 3 to 8 bits per sample instead of 56.
+class SampleCodec {
+
+public:
+  SampleCodec();
+  ~SampleCodec();
+
+  // Encoding side, a sample that doesn't fit entirely is left out
+  void beginEncode(uint8_t *buffer, size_t capacity);
+  bool encode(const sample_t &sample);
+  size_t encodedSize() const;
+
+  // Decoding side
+  void beginDecode(const uint8_t *data, size_t length);
+  bool decode(sample_t *sample);
+
+private:
+  void begin(size_t capacity);
+  bool writeBits(uint32_t value, uint8_t count);
+  bool readBits(uint32_t *value, uint8_t count);
+
+  static uint32_t zigzag(int32_t value);
+  static int32_t unzigzag(uint32_t value);
+
+  // Either the output or the input, depending on the side in use
+  uint8_t *output;
+  const uint8_t *input;
+  size_t capacityBits;
+  size_t positionBits;
+
+  // State carried from one sample to the next
+  uint32_t samples;
+  sample_t previous;
+  int32_t previousDelta;
+
+};
+
+#endif // SAMPLE_CODEC_H
@@ -0,0 +1,176 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "SensorDataBuffer.h"
+
+static void samplerThreadHandler() {
+  // Get the SensorDataBuffer instance
+  SensorDataBuffer& buffer = SensorDataBuffer::getInstance();
+
+  while (true) {
+    sample_t sample = {.centiDegrees = 2150, .uptimeMs = k_uptime_get_32(), .status = SAMPLE_STATUS_OK};
+
+    // Never blocks, what happens when the buffer is full depends on the overflow policy
+    if (buffer.push(sample) < 0) {
+      printk("Sample dropped\r\n");
+    }
+    k_msleep(1000);
+  }
+}
+
+static void uploaderThreadHandler() {
+  sample_t sample = {0};
+  sensor_data_batch_t batch = {0};
+
+  // Get the SensorDataBuffer instance
+  SensorDataBuffer& buffer = SensorDataBuffer::getInstance();
+
+  while (true) {
+    // Samples in RAM come out oldest first
+    while (buffer.pop(&sample)) {
+      printk("%u: %d\r\n", sample.uptimeMs, sample.centiDegrees);
+    }
+
+    // Then the backlog in flash, a record stays there until it's acknowledged
+    while (buffer.nextBacklog(&batch) == 0) {
+      printk("Backlog record %d: %d samples\r\n", batch.sequence, batch.count);
+      buffer.ackBacklog(batch.sequence);
+    }
+    k_msleep(8000);
+  }
+}
+*/
+
+#ifndef SENSOR_DATA_BUFFER_H
+#define SENSOR_DATA_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <atomic>
+
+#include <zephyr/kernel.h>
+
+#include "Sample.h"
+#include "BatchRecord.h"
+#include "SpscRingBuffer.h"
+#include "TimeSeriesLog.h"
+
+// Samples uploaded together
+static constexpr uint32_t SENSOR_DATA_BATCH_SIZE = 8;
+static_assert(SENSOR_DATA_BATCH_SIZE <= BATCH_RECORD_MAX_SAMPLES, "A batch must fit in a backlog record");
+
+// Macro to convert a batch source to string
+#define SENSOR_DATA_BATCH_SOURCE_TO_STRING(source) (SENSOR_DATA_BATCH_SOURCE_NAMES[(source)])
+
+// Where a batch comes from, each source numbers its batches on its own
+typedef enum {
+  SENSOR_DATA_BATCH_SOURCE_BLOCK = 0, // Block handed over by the producer, numbered by the producer
+  SENSOR_DATA_BATCH_SOURCE_RING,      // Samples taken from the RAM ring, numbered by the consumer
+  SENSOR_DATA_BATCH_SOURCE_BACKLOG,   // Record read back from flash, numbered by the backlog
+} sensor_data_batch_source_t;
+
+// Batch source to string mapping, the names the logs and the serial receiver use
+static const char *SENSOR_DATA_BATCH_SOURCE_NAMES[] = {
+  [SENSOR_DATA_BATCH_SOURCE_BLOCK]   = "block",
+  [SENSOR_DATA_BATCH_SOURCE_RING]    = "ring batch",
+  [SENSOR_DATA_BATCH_SOURCE_BACKLOG] = "backlog record"
+};
+
+// Batch of samples taken out of the buffer or the backlog for one upload, <sequence> is only unique per <source>
+typedef struct {
+  uint32_t sequence;
+  sensor_data_batch_source_t source;
+  uint32_t count;
+  sample_t samples[BATCH_RECORD_MAX_SAMPLES];
+} sensor_data_batch_t;
+
+// What happens to a new sample when the RAM ring is full
+typedef enum {
+  SENSOR_DATA_OVERFLOW_DROP_OLDEST = 0,
+  SENSOR_DATA_OVERFLOW_DROP_NEWEST,
+  SENSOR_DATA_OVERFLOW_SPILL_TO_FLASH,
+} sensor_data_overflow_policy_t;
+
+// Samples kept in RAM between the sampler and the uploader
+static constexpr uint32_t SENSOR_DATA_BUFFER_SIZE = 32;
+
+// Overflow policy of the buffer
+static constexpr sensor_data_overflow_policy_t SENSOR_DATA_BUFFER_OVERFLOW_POLICY = SENSOR_DATA_OVERFLOW_SPILL_TO_FLASH;
+
+// Storage ids of the backlog: spilled samples and batches that failed to upload, kept across reboots.
+// One batch record per id, the oldest records are overwritten once they're all used.
+// Records are compressed to about a fifth of their raw size, 64 of them take the flash 16 raw ones did.
+static constexpr uint16_t SENSOR_DATA_BACKLOG_META_ID = 0x0FF;
+static constexpr uint16_t SENSOR_DATA_BACKLOG_FIRST_ID = 0x100;
+static constexpr uint16_t SENSOR_DATA_BACKLOG_SIZE = 64;
+
+// Full spill records waiting for the normal priority work queue to write them, the sampler never touches flash itself
+static constexpr uint32_t SENSOR_DATA_SPILL_QUEUE_SIZE = 2;
+
+class SensorDataBuffer {
+public:
+  // Static method to access the singleton instance
+  static SensorDataBuffer& getInstance();
+
+  // Sampler side, flushSpill() queues a partly filled spill record for flash instead of waiting for it to fill
+  int push(const sample_t &sample);
+  int flushSpill();
+
+  // Uploader side, RAM
+  bool pop(sample_t *sample);
+  uint32_t popMany(sample_t *samples, uint32_t count);
+  uint32_t available() const;
+
+  // Uploader side, backlog in flash
+  int requeue(const sensor_data_batch_t &batch);
+  int nextBacklog(sensor_data_batch_t *batch);
+  int ackBacklog(uint32_t sequence);
+  void rewindBacklog();
+  uint32_t backlogged();
+
+  // Statistics
+  uint32_t dropped() const;
+  uint32_t spilled() const;
+
+private:
+  // Private constructor and destructor to prevent direct instantiation and destruction
+  SensorDataBuffer();
+  ~SensorDataBuffer();
+
+  int spill(const sample_t &sample);
+  bool queueSpill();
+  void refreshBacklogPending();
+  static void spillWorkHandler(struct k_work *work);
+
+  // Static member to hold the singleton instance
+  static SensorDataBuffer instance;
+
+  // Filled by the sampler thread, drained by the uploader
+  SpscRingBuffer<sample_t, SENSOR_DATA_BUFFER_SIZE> ring;
+
+  // Spilled samples and failed batches, written by the normal priority work queue and the uploader, the log
+  // serializes them
+  TimeSeriesLog backlog;
+
+  // Record filled by the sampler until it's full, then queued for the normal priority work queue to append it
+  BatchRecord spillStaging;
+  SpscRingBuffer<BatchRecord, SENSOR_DATA_SPILL_QUEUE_SIZE> spillQueue;
+  struct k_work spillWork;
+
+  // Records in the backlog as last seen off the sampler thread, reading the log may wait for flash
+  std::atomic<uint32_t> backlogPending;
+
+  // Statistics
+  std::atomic<uint32_t> droppedCount;
+  std::atomic<uint32_t> spilledCount;
+};
+
+#endif // SENSOR_DATA_BUFFER_H
@@ -8,7 +8,6 @@ Usage example:
 // Zephyr includes
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
-#include <zephyr/sys/printk.h>
 
 // User C++ class headers
 #include "Serial.h"
@@ -16,31 +15,30 @@ Usage example:
 // Thread handler function declaration
 static void serialThreadHandler();
 
-// Delay value used inside thread loops to yield back to scheduler
-static constexpr uint32_t SERIAL_THREAD_SLEEP_TIME_MS = 1000;
-
 // Threads definition
 K_THREAD_DEFINE(serialThread, 1024, serialThreadHandler, NULL, NULL, NULL, 7, 0, 0);
 
 static void serialThreadHandler() {
-  // Variable to hold serial reading in Celsius
-  double serialReading = 0;
+  // Buffer to hold what was received
+  uint8_t data[64];
+  int length = 0;
 
   // Reference serial device from device tree
   const struct device *serialDevice = DEVICE_DT_GET(DT_NODELABEL(usart2));
 
-  // Create local object using the device
+  // Create local object using the device, reception starts right away
   Serial serial(serialDevice);
 
-  // Register receive callback as a lambda callback
-  serial.onReceive([](uint8_t *data, uint32_t length) {
-    printk("Received: %.*s", length, data);
-  });
-
-  // Continuously read serial
+  // Echo whatever arrives, giving up after a second of silence
   while (true) {
-    serial.write("Hello world!\r\n");;
-    k_msleep(SERIAL_THREAD_SLEEP_TIME_MS);
+    length = serial.read(data, sizeof(data), K_SECONDS(1));
+    if (length > 0) {
+      // Returns as soon as the bytes are queued, the UART sends them in the background
+      serial.write(data, length);
+    } else {
+      serial.write((const uint8_t *)"Nothing received\r\n", 18);
+      serial.flush(K_MSEC(100));
+    }
   }
 }
 */
@@ -49,8 +47,47 @@ static void serialThreadHandler() {
 #define SERIAL_H
 
 #include <stdint.h>
+#include <atomic>
 #include <functional>
 
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/uart.h>
+
+#include "SpscRingBuffer.h"
+
+// Reception buffers handed to the UART DMA, two of them so one fills while the other is drained
+static constexpr uint32_t SERIAL_RX_DMA_BUFFER_SIZE = 64;
+
+// Line idle time after which received bytes are handed over before the DMA buffer is full
+static constexpr int32_t SERIAL_RX_IDLE_TIMEOUT_US = 1000;
+
+// Received bytes waiting for read(), about 90 ms of traffic at 115200 baud
+static constexpr uint32_t SERIAL_RX_RING_SIZE = 1024;
+
+// Bytes handed to the UART in one DMA transfer, or one refill of the FIFO
+static constexpr uint32_t SERIAL_TX_DMA_BUFFER_SIZE = 64;
+
+// Bytes queued by write() and not sent yet, a 1 KB dump fits without blocking
+static constexpr uint32_t SERIAL_TX_RING_SIZE = 1024;
+
+// How the UART is driven, the best one the device supports is picked at construction
+typedef enum {
+  SERIAL_MODE_ASYNC = 0,
+  SERIAL_MODE_INTERRUPT,
+  SERIAL_MODE_POLLING,
+} serial_mode_t;
+
+// What the serial port went through since boot
+typedef struct {
+  uint32_t rxBytes;
+  uint32_t rxOverruns;
+  uint32_t rxErrors;
+  uint32_t txBytes;
+  uint32_t txOverruns;
+  uint32_t txErrors;
+  uint32_t txQueueHighWater;
+} serial_stats_t;
+
 class Serial {
 
 public:
@@ -60,11 +97,66 @@ public:
   Serial(const struct device *device);
   ~Serial();
 
-  void write(uint8_t *data, uint32_t length);
-  void read(uint8_t *data, uint32_t *length);
+  // Queues the bytes and returns right away with how many were queued, the rest is counted as overrun.
+  // Safe to call from several threads, bytes of one call are never interleaved with another one.
+  int write(const uint8_t *data, uint32_t length);
+
+  // Waits until every queued byte left the UART, returns -EAGAIN on timeout
+  int flush(k_timeout_t timeout);
+
+  // Called from ISR context every time the transmit queue runs empty
+  void onWriteComplete(std::function<void()> callback);
+
+  // Waits up to <timeout> for the first bytes, then returns whatever was received up to <size>.
+  // Returns -EAGAIN when nothing arrived in time.
+  int read(uint8_t *data, uint32_t size, k_timeout_t timeout);
+
+  // Called from ISR context with every chunk received, keep it short or use read() instead
   void onReceive(std::function<void(uint8_t *, uint32_t)> callback);
 
+  serial_stats_t stats() const;
+
 private:
+  static void asyncCallback(const struct device *dev, struct uart_event *event, void *userData);
+  static void irqCallback(const struct device *dev, void *userData);
+
+  // Hands received bytes over to read(), from ISR context
+  void received(uint8_t *data, uint32_t length);
+
+  // Starts sending the next queued bytes if the UART is idle, returns false when there are none.
+  // Called with <txSpinLock> held, from write() or from ISR context once a transfer is done.
+  bool transmitNext();
+  void transmitted();
+
+  // Async API with DMA when the UART supports it, interrupt-driven FIFOs otherwise, polling as a last resort
+  serial_mode_t mode;
+  uint8_t rxBuffers[2][SERIAL_RX_DMA_BUFFER_SIZE];
+  uint8_t nextRxBuffer;
+
+  SpscRingBuffer<uint8_t, SERIAL_RX_RING_SIZE> rxRing;
+  struct k_sem rxReady;
+
+  // Writers queue under the mutex, the ISR drains the queue through the staging buffer
+  SpscRingBuffer<uint8_t, SERIAL_TX_RING_SIZE> txRing;
+  struct k_mutex txMutex;
+  struct k_spinlock txSpinLock;
+  struct k_event txEvents;
+  bool txBusy;
+  uint8_t txBuffer[SERIAL_TX_DMA_BUFFER_SIZE];
+  uint32_t txLength;
+  uint32_t txOffset;
+  std::function<void()> writeCompleteCallback;
+
+  // Updated from ISR context and from the writers, stats() takes a snapshot of them
+  struct {
+    std::atomic<uint32_t> rxBytes;
+    std::atomic<uint32_t> rxOverruns;
+    std::atomic<uint32_t> rxErrors;
+    std::atomic<uint32_t> txBytes;
+    std::atomic<uint32_t> txOverruns;
+    std::atomic<uint32_t> txErrors;
+    std::atomic<uint32_t> txQueueHighWater;
+  } counters;
 };
 
 #endif // SERIAL_H
@@ -0,0 +1,107 @@
+/*
+Usage example:
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "SerialUplink.h"
+
+// Thread handler function declaration
+static void uplinkThreadHandler();
+
+// Threads definition
+K_THREAD_DEFINE(uplinkThread, 2048, uplinkThreadHandler, NULL, NULL, NULL, 7, 0, 0);
+
+static void uplinkThreadHandler() {
+  sensor_data_batch_t batch = {.sequence = 0, .source = SENSOR_DATA_BATCH_SOURCE_RING, .count = 1};
+  int ret = 0;
+
+  // Frames go out on usart2, scripts/serial/receiver.py acknowledges them on the other end
+  SerialUplink uplink(DEVICE_DT_GET(DT_NODELABEL(usart2)));
+
+  while (true) {
+    batch.samples[0] = {.centiDegrees = 2150, .uptimeMs = k_uptime_get_32(), .status = SAMPLE_STATUS_OK};
+
+    // Blocks until the receiver acknowledged the frame, retransmitting it on timeout
+    ret = uplink.send(batch);
+    printk("Ring batch %d %s\r\n", batch.sequence, (ret == 0) ? "acknowledged" : "lost");
+
+    batch.sequence++;
+    k_msleep(1000);
+  }
+}
+*/
+
+#ifndef SERIAL_UPLINK_H
+#define SERIAL_UPLINK_H
+
+#include <stdint.h>
+
+#include "Serial.h"
+#include "SensorDataBuffer.h"
+
+// Frame types, the receiver answers every valid data frame with an ack carrying the same session and sequence number
+typedef enum {
+  SERIAL_UPLINK_FRAME_DATA = 0x01,
+  SERIAL_UPLINK_FRAME_ACK = 0x02,
+} serial_uplink_frame_t;
+
+// Frame, before COBS encoding: type (1), session (2), sequence (2), payload, CRC-16/CCITT of everything before it (2).
+// The session is drawn at random at boot, so the receiver doesn't take the restarted sequence numbers for
+// retransmissions. Data payload: batch sequence (4), batch source (1), sample count (1), then the packed samples. Little endian throughout.
+static constexpr uint32_t SERIAL_UPLINK_HEADER_SIZE = 5;
+static constexpr uint32_t SERIAL_UPLINK_CRC_SIZE = 2;
+static constexpr uint32_t SERIAL_UPLINK_MAX_PAYLOAD = 6 + (BATCH_RECORD_MAX_SAMPLES * sizeof(sample_t));
+static constexpr uint32_t SERIAL_UPLINK_MAX_FRAME = SERIAL_UPLINK_HEADER_SIZE + SERIAL_UPLINK_MAX_PAYLOAD +
+                                                    SERIAL_UPLINK_CRC_SIZE;
+
+// COBS adds one byte per 254, and frames are wrapped in zero delimiters so a receiver resyncs on the next one
+static constexpr uint32_t SERIAL_UPLINK_MAX_ENCODED = SERIAL_UPLINK_MAX_FRAME + (SERIAL_UPLINK_MAX_FRAME / 254) + 3;
+
+// Stop-and-wait retransmission
+static constexpr int32_t SERIAL_UPLINK_ACK_TIMEOUT_MS = 200;
+static constexpr uint32_t SERIAL_UPLINK_MAX_RETRANSMIT = 3;
+
+// What the uplink went through since boot
+typedef struct {
+  uint32_t framesSent;
+  uint32_t retransmissions;
+  uint32_t acknowledged;
+  uint32_t badFrames;
+} serial_uplink_stats_t;
+
+// Wired fallback uplink, sample batches in COBS framed, checksummed and acknowledged frames
+class SerialUplink {
+
+public:
+  SerialUplink(const struct device *device);
+  ~SerialUplink();
+
+  // Blocks until the batch is acknowledged, returns -ETIMEDOUT once every retransmission went unanswered
+  int send(const sensor_data_batch_t &batch);
+
+  serial_uplink_stats_t stats() const;
+
+private:
+  // Waits for an ack of <sequence>, dropping anything else on the way
+  bool waitForAck(uint16_t sequence, int32_t timeoutMs);
+
+  static uint32_t cobsEncode(const uint8_t *data, uint32_t length, uint8_t *output);
+  static int cobsDecode(const uint8_t *data, uint32_t length, uint8_t *output);
+
+  Serial serial;
+  uint16_t session;
+  uint16_t sequence;
+  serial_uplink_stats_t statistics;
+
+  // Only used by the thread calling send()
+  uint8_t frame[SERIAL_UPLINK_MAX_FRAME];
+  uint8_t encoded[SERIAL_UPLINK_MAX_ENCODED];
+  uint8_t received[SERIAL_UPLINK_MAX_ENCODED];
+  uint32_t receivedLength;
+};
+
+#endif // SERIAL_UPLINK_H
@@ -0,0 +1,167 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "SpscRingBuffer.h"
+
+// Shared between exactly one producer thread and one consumer thread
+static SpscRingBuffer<uint32_t, 16> ring;
+
+static void producerThreadHandler() {
+  uint32_t counter = 0;
+
+  while (true) {
+    // Never blocks, refuses the value when the ring is full
+    if (!ring.push(counter++)) {
+      printk("Ring is full\r\n");
+    }
+    k_msleep(100);
+  }
+}
+
+static void consumerThreadHandler() {
+  uint32_t value = 0;
+
+  while (true) {
+    // Drain whatever is available
+    while (ring.pop(&value)) {
+      printk("Got %d\r\n", value);
+    }
+    k_msleep(1000);
+  }
+}
+*/
+
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <atomic>
+#include <type_traits>
+
+// Lock-free ring shared by one producer and one consumer, neither side ever blocks.
+// Indexes run freely and are only wrapped when accessing the storage, so a full ring
+// (head - tail == SIZE) can be told apart from an empty one (head == tail).
+template <typename T, uint32_t SIZE>
+class SpscRingBuffer {
+  static_assert((SIZE > 0) && ((SIZE & (SIZE - 1)) == 0), "Ring size must be a power of two");
+  static_assert(std::is_trivially_copyable<T>::value, "Ring items are copied in and out with plain assignment");
+
+public:
+  SpscRingBuffer() : head(0), tail(0) {
+  }
+
+  // Producer side: false when the ring is full
+  bool push(const T &item) {
+    uint32_t head = this->head.load(std::memory_order_relaxed);
+
+    if ((head - this->tail.load(std::memory_order_acquire)) >= SIZE) {
+      return false;
+    }
+
+    this->items[head & (SIZE - 1)] = item;
+    this->head.store(head + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  // Producer side: always stores the item, evicting the oldest one when the ring is full.
+  // Returns true when an item was evicted.
+  bool pushOverwrite(const T &item) {
+    uint32_t head = this->head.load(std::memory_order_relaxed);
+    uint32_t tail = this->tail.load(std::memory_order_acquire);
+    bool evicted = false;
+
+    // The consumer may be popping that same oldest item, whoever moves the tail first owns it
+    if ((head - tail) >= SIZE) {
+      evicted = this->tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel);
+    }
+
+    this->items[head & (SIZE - 1)] = item;
+    this->head.store(head + 1, std::memory_order_release);
+
+    return evicted;
+  }
+
+  // Consumer side: false when the ring is empty
+  bool pop(T *item) {
+    uint32_t tail = this->tail.load(std::memory_order_acquire);
+
+    while (tail != this->head.load(std::memory_order_acquire)) {
+      *item = this->items[tail & (SIZE - 1)];
+
+      // Losing the race means the producer evicted this item (and may have overwritten the
+      // copy just taken), retry with the new oldest item
+      if (this->tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // Producer side: copies as many items as fit, returns how many, published all at once
+  uint32_t write(const T *data, uint32_t count) {
+    uint32_t head = this->head.load(std::memory_order_relaxed);
+    uint32_t room = SIZE - (head - this->tail.load(std::memory_order_acquire));
+
+    count = (count < room) ? count : room;
+    for (uint32_t index = 0; index < count; index++) {
+      this->items[(head + index) & (SIZE - 1)] = data[index];
+    }
+    this->head.store(head + count, std::memory_order_release);
+
+    return count;
+  }
+
+  // Consumer side: copies up to <count> items, returns how many, 0 when the ring is empty
+  uint32_t read(T *data, uint32_t count) {
+    uint32_t tail = this->tail.load(std::memory_order_acquire);
+    uint32_t available = 0;
+
+    do {
+      available = this->head.load(std::memory_order_acquire) - tail;
+      available = (count < available) ? count : available;
+      for (uint32_t index = 0; index < available; index++) {
+        data[index] = this->items[(tail + index) & (SIZE - 1)];
+      }
+      // Same race as pop() with an overwriting producer, start over from the new oldest item
+    } while ((available > 0) &&
+             !this->tail.compare_exchange_weak(tail, tail + available, std::memory_order_acq_rel));
+
+    return available;
+  }
+
+  // Either side, the value may already be outdated when it's used
+  uint32_t size() const {
+    // Tail first, the head can only have moved further since
+    uint32_t tail = this->tail.load(std::memory_order_acquire);
+
+    return this->head.load(std::memory_order_acquire) - tail;
+  }
+
+  bool isEmpty() const {
+    return this->size() == 0;
+  }
+
+  static constexpr uint32_t capacity() {
+    return SIZE;
+  }
+
+private:
+  T items[SIZE];
+
+  // Written by the producer only (head) and by the consumer, or an overwriting producer (tail)
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+};
+
+#endif // SPSC_RING_BUFFER_H
@@ -32,6 +32,11 @@ static void storageThreadHandler() {
   // Get the Storage instance
   Storage& storage = Storage::getInstance();
 
+  // NVS is mounted in the background after boot, every call waits for it anyway
+  if (storage.waitUntilReady(K_SECONDS(5)) == 0) {
+    printk("NVS mounted in %u ms\r\n", storage.mountTimeMs());
+  }
+
   // Write data to NVS
   ret = storage.write(IP_ADDRESS_ID, (uint8_t *)"192.168.1.2", sizeof("192.168.1.2")-1);
   if (ret > 0) {
@@ -79,6 +84,12 @@ static void storageThreadHandler() {
 
   printk("jsonString = %s", jsonString);
 
+  // Writes are absorbed by the cache, push them to flash before a planned reset
+  storage.sync();
+
+  // Or skip the cache for data that must survive an unplanned one
+  storage.write(IP_ADDRESS_ID, (uint8_t *)"192.168.1.3", sizeof("192.168.1.3")-1, true);
+
   while (true) {
     k_msleep(STORAGE_THREAD_SLEEP_TIME_MS);
   }
@@ -91,7 +102,48 @@ static void storageThreadHandler() {
 #include <stdlib.h>
 #include <stdint.h>
 
-#include <zephyr/fs/nvs.h>
+#include <zephyr/kernel.h>
+
+#include "BatchRecord.h"
+#include "StorageBackend.h"
+
+// Where entries end up
+typedef enum {
+  STORAGE_BACKEND_NVS = 0,
+  STORAGE_BACKEND_RAM,
+} storage_backend_t;
+
+// Backend selected at build time, NVS on the storage partition by default
+static constexpr storage_backend_t STORAGE_BACKEND = STORAGE_BACKEND_NVS;
+
+// NVS sectors used in the storage partition, mounting scans all of them so it takes longer as this grows
+static constexpr uint16_t STORAGE_SECTOR_COUNT = 2;
+
+// Write-back cache in front of NVS, entries larger than a cache line and durable writes are written through
+static constexpr bool STORAGE_CACHE_ENABLED = true;
+static constexpr uint32_t STORAGE_CACHE_ENTRIES = 8;
+static constexpr uint32_t STORAGE_CACHE_ENTRY_SIZE = 128;
+
+// Dirty entries budget, reaching it flushes the cache from the writing thread
+static constexpr uint32_t STORAGE_CACHE_HIGH_WATER = 6;
+
+// Dirty entries are flushed from the normal priority work queue at the latest this long after being written
+static constexpr int32_t STORAGE_CACHE_FLUSH_PERIOD_MS = 5000;
+
+// Counters to tune the cache
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t coalesced;
+  uint32_t flushes;
+  uint32_t flushedEntries;
+  uint32_t lastFlushUs;
+  uint32_t maxFlushUs;
+
+  // Batch records as handed over and as actually stored, the ratio is what compression saves
+  uint32_t batchBytesRaw;
+  uint32_t batchBytesStored;
+} storage_cache_stats_t;
 
 class Storage {
 public:
@@ -99,20 +151,73 @@ public:
   static Storage& getInstance();
 
   int read(uint16_t id, void *buffer, size_t length);
-  int write(uint16_t id, void *data, size_t length);
+  // A durable write is on flash when it returns, for entries a reset must not lose
+  int write(uint16_t id, void *data, size_t length, bool durable = false);
+  int readBatch(uint16_t id, BatchRecord *record);
+  int writeBatch(uint16_t id, BatchRecord &record, bool durable = false);
   int remove(uint16_t id);
   int clear();
+  int sync();
+  storage_cache_stats_t cacheStats();
+  StorageBackend& backend();
+
+  // NVS is mounted from the normal priority work queue after boot, <EVENT_STORAGE_READY> is published
+  // on <controlChannel> once it's done. Calls made before then wait for it, writes that fit the
+  // cache return right away.
+  bool isReady();
+  int waitUntilReady(k_timeout_t timeout);
+  uint32_t mountTimeMs() const;
+
+  // Runs <work> on the normal priority work queue, after the mount, for callers that must never wait for flash
+  void submit(struct k_work *work);
 
 private:
   // Private constructor and destructor to prevent direct instantiation and destruction
   Storage();
   ~Storage();
 
+  struct cacheEntry {
+    bool valid;
+    bool dirty;
+    uint16_t id;
+    uint16_t length;
+    uint32_t lastUsed;
+    uint32_t lastWritten;
+    uint8_t data[STORAGE_CACHE_ENTRY_SIZE];
+  };
+
+  struct cacheEntry *cacheFind(uint16_t id);
+  struct cacheEntry *cacheAllocate();
+  int waitMounted();
+  int flush();
+  static void mountWorkHandler(struct k_work *work);
+  static void flushWorkHandler(struct k_work *work);
+
   // Static member to hold the singleton instance
   static Storage instance;
 
-  // NVS file system, internally protected by a mutex
-  struct nvs_fs fs;
+  // Backend selected by STORAGE_BACKEND, NVS internally protects itself with a mutex
+  StorageBackend *store;
+
+  // Background mount, the result is valid once STORAGE_EVENT_MOUNTED is posted
+  struct k_work_q *workQueue;
+  struct k_work mountWork;
+  struct k_event events;
+  int mountResult;
+  uint32_t mountDurationMs;
+
+  // Protects the cache, always taken before the backend mutex
+  struct k_mutex mutex;
+
+  // Write-back cache
+  struct cacheEntry cache[STORAGE_CACHE_ENTRIES];
+  uint32_t cacheClock;
+  uint32_t dirtyCount;
+  struct k_work_delayable flushWork;
+  storage_cache_stats_t stats;
+
+  // Stored form of a batch record, kept here rather than on the callers stack
+  uint8_t batchBuffer[BatchRecord::capacity()];
 };
 
 #endif // STORAGE_H
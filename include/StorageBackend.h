@@ -0,0 +1,67 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+
+// Zephyr includes
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+// User C++ class headers
+#include "RamStorageBackend.h"
+
+static void measureSomething() {
+  static ram_storage_entry_t entries[1];
+  static RamStorageBackend backend(entries, ARRAY_SIZE(entries));
+  uint8_t record[32] = {0};
+
+  // Any backend is driven the same way, Storage only sees this interface
+  StorageBackend& store = backend;
+
+  store.mount();
+  store.write(1, record, sizeof(record));
+  store.read(1, record, sizeof(record));
+
+  storage_backend_stats_t stats = store.stats();
+  printk("%s: %u bytes written, %u erases\r\n", store.name(), stats.bytesWritten, stats.erases);
+}
+*/
+
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// What a backend did so far, flash backends also report erases and the writes that had to wait for them
+typedef struct {
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t bytesRead;
+  uint32_t bytesWritten;
+  uint32_t erases;
+  uint32_t gcPauses;
+  uint32_t lastGcPauseUs;
+  uint32_t maxGcPauseUs;
+} storage_backend_stats_t;
+
+// Key-value store under Storage, entries are addressed by a 16-bit id like in NVS.
+// Calls return the same values as the NVS API: lengths on success, negative errno otherwise.
+class StorageBackend {
+public:
+  virtual ~StorageBackend() = default;
+
+  virtual const char *name() const = 0;
+  virtual int mount() = 0;
+  virtual ssize_t read(uint16_t id, void *buffer, size_t length) = 0;
+  virtual ssize_t write(uint16_t id, const void *data, size_t length) = 0;
+  virtual int remove(uint16_t id) = 0;
+  virtual int clear() = 0;
+  virtual ssize_t freeSpace() = 0;
+  virtual storage_backend_stats_t stats() const = 0;
+  virtual void resetStats() = 0;
+};
+
+#endif // STORAGE_BACKEND_H
@@ -38,17 +38,39 @@ static void temperatureThreadHandler() {
     k_msleep(TEMPERATURE_THREAD_SLEEP_TIME_MS);
   }
 }
+
+static void temperatureFixedPointThreadHandler() {
+  // Variable to hold the fixed-point temperature reading, its timestamp and status
+  sample_t sample = {0};
+
+  // Reference die temperature device from device tree
+  const struct device *temperatureDevice = DEVICE_DT_GET(DT_NODELABEL(die_temp));
+
+  // Create local object using the device
+  Temperature temperature(temperatureDevice);
+
+  // Continuously read temperature without any floating point math
+  while (true) {
+    if (temperature.read(&sample) == 0) {
+      printk("CPU temperature: %d hundredths of °C at %u ms\r\n", sample.centiDegrees, sample.uptimeMs);
+    }
+    k_msleep(TEMPERATURE_THREAD_SLEEP_TIME_MS);
+  }
+}
 */
 
 #ifndef TEMPERATURE_H
 #define TEMPERATURE_H
 
+#include "Sample.h"
+
 class Temperature {
 
 public:
   Temperature(const struct device *device);
   ~Temperature();
   double read();
+  int read(sample_t *sample);
 
 private:
   const struct device *_device;
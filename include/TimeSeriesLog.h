@@ -0,0 +1,104 @@
+/*
+Usage example:
+
+// Lib C includes
+#include <stdint.h>
+
+// Zephyr includes
+#include <zephyr/sys/printk.h>
+
+// User C++ class headers
+#include "TimeSeriesLog.h"
+
+// 16 records at ids 0x300 to 0x30F, head and tail persisted at id 0x2FF
+static TimeSeriesLog history(0x300, 16, 0x2FF);
+
+static void storeSomething(const sample_t *samples, uint16_t count) {
+  BatchRecord record;
+
+  record.begin(0);
+  for (uint16_t index = 0; index < count; index++) {
+    record.append(samples[index]);
+  }
+
+  // The log numbers the record, the oldest one is overwritten once the log is full
+  history.append(record);
+}
+
+static void forwardSomething() {
+  BatchRecord record;
+
+  // Records come out oldest first and stay in the log until they're acknowledged
+  while (history.next(&record) == 0) {
+    if (sendSomewhere(record)) {
+      history.ack(record.sequence());
+    } else {
+      // Read the unacknowledged records again next time
+      history.rewind();
+      break;
+    }
+  }
+}
+*/
+
+#ifndef TIME_SERIES_LOG_H
+#define TIME_SERIES_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <zephyr/kernel.h>
+
+#include "BatchRecord.h"
+
+// Append-only log of batch records over a range of Storage ids, survives reboots.
+// Records are numbered with a sequence that only grows, a record lives at id
+// firstId + (sequence % capacity), head and tail sequences are persisted in their own entry.
+class TimeSeriesLog {
+
+public:
+  TimeSeriesLog(uint16_t firstId, uint16_t capacity, uint16_t metaId);
+  ~TimeSeriesLog();
+
+  // Writer side
+  int append(BatchRecord &record);
+
+  // Reader side: next() walks unread records, ack() commits everything up to a sequence,
+  // rewind() goes back to the oldest record not acknowledged yet
+  int next(BatchRecord *record);
+  int ack(uint32_t sequence);
+  void rewind();
+
+  uint32_t pending();
+  uint32_t unread();
+  uint32_t overwritten() const;
+
+private:
+  // Persisted head and tail
+  typedef struct {
+    uint32_t head;
+    uint32_t tail;
+  } meta_t;
+
+  int open();
+  int persist();
+  uint16_t idOf(uint32_t sequence) const;
+
+  uint16_t firstId;
+  uint16_t capacity;
+  uint16_t metaId;
+
+  // Writer and reader usually live in different threads
+  struct k_mutex mutex;
+  bool opened;
+
+  // Next sequence to append, oldest sequence not acknowledged, next sequence to read
+  meta_t meta;
+  uint32_t readCursor;
+
+  // Records lost to wraparound before being acknowledged
+  uint32_t overwrittenCount;
+
+};
+
+#endif // TIME_SERIES_LOG_H
@@ -0,0 +1,217 @@
+import socket
+import struct
+import sys
+import threading
+import time
+
+# CoAP message types and codes used by the device
+COAP_TYPE_CON = 0
+COAP_TYPE_NON = 1
+COAP_TYPE_ACK = 2
+COAP_TYPE_RST = 3
+
+COAP_CODE_POST = 0x02
+COAP_CODE_GET = 0x01
+COAP_CODE_CHANGED = 0x44
+COAP_CODE_CONTENT = 0x45
+COAP_CODE_CONTINUE = 0x5F
+COAP_CODE_NOT_FOUND = 0x84
+
+COAP_OPTION_OBSERVE = 6
+COAP_OPTION_URI_PATH = 11
+COAP_OPTION_CONTENT_FORMAT = 12
+COAP_OPTION_BLOCK1 = 27
+
+# Bytes on the wire per transport, printed after every exchange
+statistics = {"coap": [0, 0], "http": [0, 0]}
+
+def parse_coap(datagram):
+    version_type_tkl, code = datagram[0], datagram[1]
+    message_id = struct.unpack("!H", datagram[2:4])[0]
+    message_type = (version_type_tkl >> 4) & 0x03
+    token_length = version_type_tkl & 0x0F
+    token = datagram[4:4 + token_length]
+
+    options = []
+    position = 4 + token_length
+    number = 0
+    while position < len(datagram) and datagram[position] != 0xFF:
+        delta, length = datagram[position] >> 4, datagram[position] & 0x0F
+        position += 1
+        if delta == 13:
+            delta = datagram[position] + 13
+            position += 1
+        elif delta == 14:
+            delta = struct.unpack("!H", datagram[position:position + 2])[0] + 269
+            position += 2
+        if length == 13:
+            length = datagram[position] + 13
+            position += 1
+        elif length == 14:
+            length = struct.unpack("!H", datagram[position:position + 2])[0] + 269
+            position += 2
+        number += delta
+        options.append((number, datagram[position:position + length]))
+        position += length
+
+    payload = datagram[position + 1:] if position < len(datagram) else b""
+    return message_type, code, message_id, token, options, payload
+
+def encode_nibble(value):
+    # Returns the 4-bit field and its extended bytes (RFC 7252 section 3.1)
+    if value < 13:
+        return value, b""
+    if value < 269:
+        return 13, bytes([value - 13])
+    return 14, struct.pack("!H", value - 269)
+
+def encode_option(previous, number, value):
+    delta, delta_extended = encode_nibble(number - previous)
+    length, length_extended = encode_nibble(len(value))
+    return bytes([(delta << 4) | length]) + delta_extended + length_extended + value
+
+def encode_uint(value):
+    if value == 0:
+        return b""
+    return value.to_bytes((value.bit_length() + 7) // 8, "big")
+
+def build_coap(message_type, code, message_id, token, options=(), payload=b""):
+    datagram = bytes([0x40 | (message_type << 4) | len(token), code]) + struct.pack("!H", message_id) + token
+    previous = 0
+    for number, value in sorted(options, key=lambda option: option[0]):
+        datagram += encode_option(previous, number, value)
+        previous = number
+    if payload:
+        datagram += b"\xff" + payload
+    return datagram
+
+def run_coap_server(port, notify_period):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", port))
+    print(f"CoAP stand-in listening on udp/{port}")
+
+    body = b""
+    observers = {}
+    lock = threading.Lock()
+
+    def notify():
+        sequence = 2
+        message_id = 0x8000
+        while True:
+            time.sleep(notify_period)
+            with lock:
+                for (address, token) in list(observers.items()):
+                    notification = build_coap(COAP_TYPE_NON, COAP_CODE_CONTENT, message_id, token,
+                                              [(COAP_OPTION_OBSERVE, encode_uint(sequence))],
+                                              b'{"period":1000}')
+                    sock.sendto(notification, address)
+                    statistics["coap"][1] += len(notification)
+                    message_id = (message_id + 1) & 0xFFFF
+                sequence += 1
+
+    threading.Thread(target=notify, daemon=True).start()
+
+    while True:
+        datagram, address = sock.recvfrom(2048)
+        statistics["coap"][0] += len(datagram)
+        message_type, code, message_id, token, options, payload = parse_coap(datagram)
+        path = "/".join(value.decode() for (number, value) in options if number == COAP_OPTION_URI_PATH)
+        reply_type = COAP_TYPE_ACK if message_type == COAP_TYPE_CON else COAP_TYPE_NON
+
+        if message_type in (COAP_TYPE_ACK, COAP_TYPE_RST):
+            # The device acknowledged or refused a notification
+            if message_type == COAP_TYPE_RST:
+                with lock:
+                    observers.pop(address, None)
+            continue
+
+        if code == COAP_CODE_POST and path == "data":
+            block1 = [value for (number, value) in options if number == COAP_OPTION_BLOCK1]
+            if block1:
+                block = int.from_bytes(block1[0], "big")
+                if (block >> 4) == 0:
+                    body = b""
+                body += payload
+                if block & 0x08:
+                    reply = build_coap(reply_type, COAP_CODE_CONTINUE, message_id, token,
+                                       [(COAP_OPTION_BLOCK1, block1[0])])
+                else:
+                    print(f"POST /{path} ({len(body)} bytes, block-wise): {body.decode(errors='replace')}")
+                    reply = build_coap(reply_type, COAP_CODE_CHANGED, message_id, token,
+                                       [(COAP_OPTION_BLOCK1, block1[0])])
+            else:
+                print(f"POST /{path} ({len(payload)} bytes): {payload.decode(errors='replace')}")
+                reply = build_coap(reply_type, COAP_CODE_CHANGED, message_id, token)
+        elif code == COAP_CODE_GET:
+            observe = [value for (number, value) in options if number == COAP_OPTION_OBSERVE]
+            reply_options = []
+            if observe:
+                with lock:
+                    if int.from_bytes(observe[0], "big") == 0:
+                        observers[address] = token
+                        reply_options.append((COAP_OPTION_OBSERVE, encode_uint(1)))
+                    else:
+                        observers.pop(address, None)
+            reply = build_coap(reply_type, COAP_CODE_CONTENT, message_id, token, reply_options, b'{"period":1000}')
+        else:
+            reply = build_coap(reply_type, COAP_CODE_NOT_FOUND, message_id, token)
+
+        sock.sendto(reply, address)
+        statistics["coap"][1] += len(reply)
+        print_statistics()
+
+def run_http_server(port):
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(("0.0.0.0", port))
+    server.listen(4)
+    print(f"HTTP stand-in listening on tcp/{port}")
+
+    while True:
+        connection, address = server.accept()
+        threading.Thread(target=serve_http_connection, args=(connection,), daemon=True).start()
+
+def serve_http_connection(connection):
+    # Bytes are counted at the socket level, TCP/IP overhead comes on top for both transports
+    pending = b""
+    with connection:
+        while True:
+            data = connection.recv(2048)
+            if not data:
+                return
+            statistics["http"][0] += len(data)
+            pending += data
+
+            # Wait for the whole chunked or Content-Length body before answering
+            if b"\r\n\r\n" not in pending:
+                continue
+            head, body = pending.split(b"\r\n\r\n", 1)
+            if b"chunked" in head.lower():
+                if not body.endswith(b"0\r\n\r\n"):
+                    continue
+            else:
+                length = 0
+                for line in head.split(b"\r\n"):
+                    if line.lower().startswith(b"content-length:"):
+                        length = int(line.split(b":", 1)[1])
+                if len(body) < length:
+                    continue
+
+            print(f"{head.split(b' ')[0].decode()} {head.split(b' ')[1].decode()} ({len(pending)} bytes)")
+            reply = b"HTTP/1.1 200 OK\r\nContent-Length: 2\r\nContent-Type: text/plain\r\n\r\nOK"
+            connection.sendall(reply)
+            statistics["http"][1] += len(reply)
+            pending = b""
+            print_statistics()
+
+def print_statistics():
+    for transport, (received, sent) in statistics.items():
+        print(f"  {transport}: {received} bytes received, {sent} bytes sent")
+
+if __name__ == "__main__":
+    # Usage: python standin_server.py [coap port] [http port]
+    coap_port = int(sys.argv[1]) if len(sys.argv) > 1 else 5683
+    http_port = int(sys.argv[2]) if len(sys.argv) > 2 else 1880
+
+    threading.Thread(target=run_http_server, args=(http_port,), daemon=True).start()
+    run_coap_server(coap_port, notify_period=10)
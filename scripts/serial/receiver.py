@@ -0,0 +1,176 @@
+import os
+import struct
+import sys
+import termios
+import tty
+
+# Frame types, see include/SerialUplink.h
+FRAME_DATA = 0x01
+FRAME_ACK = 0x02
+
+# Packed sample_t: centiDegrees (int16), uptimeMs (uint32), status (uint8)
+SAMPLE_FORMAT = "<hIB"
+SAMPLE_SIZE = struct.calcsize(SAMPLE_FORMAT)
+BATCH_FORMAT = "<IBB"
+BATCH_HEADER_SIZE = struct.calcsize(BATCH_FORMAT)
+# Each source numbers its batches apart, in the order of sensor_data_batch_source_t
+BATCH_SOURCES = ("block", "ring batch", "backlog record")
+
+BAUD_RATES = {9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400,
+              57600: termios.B57600, 115200: termios.B115200}
+
+# Frames seen since start, printed after every batch
+statistics = {"frames": 0, "duplicates": 0, "bad": 0}
+
+def crc16_ccitt(data, crc=0xFFFF):
+    # Same as Zephyr's crc16_ccitt(): reflected polynomial 0x8408, no final XOR
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+def cobs_encode(data):
+    output = bytearray([0])
+    code_index, code = 0, 1
+    for byte in data:
+        if byte == 0:
+            output[code_index] = code
+            code_index, code = len(output), 1
+            output.append(0)
+            continue
+        output.append(byte)
+        code += 1
+        if code == 0xFF:
+            output[code_index] = code
+            code_index, code = len(output), 1
+            output.append(0)
+    output[code_index] = code
+    return bytes(output)
+
+def cobs_decode(data):
+    output = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        index += 1
+        if code == 0 or index + code - 1 > len(data):
+            raise ValueError("malformed COBS block")
+        output += data[index:index + code - 1]
+        index += code - 1
+        if code < 0xFF and index < len(data):
+            output.append(0)
+    return bytes(output)
+
+# Type, session and sequence number, the session changes at every boot of the device
+HEADER_FORMAT = "<BHH"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+def build_frame(frame_type, session, sequence, payload=b""):
+    frame = struct.pack(HEADER_FORMAT, frame_type, session, sequence) + payload
+    frame += struct.pack("<H", crc16_ccitt(frame))
+    return b"\x00" + cobs_encode(frame) + b"\x00"
+
+def parse_frame(encoded):
+    frame = cobs_decode(encoded)
+    if len(frame) < HEADER_SIZE + 2 or crc16_ccitt(frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+        raise ValueError("bad CRC")
+    frame_type, session, sequence = struct.unpack(HEADER_FORMAT, frame[:HEADER_SIZE])
+    return frame_type, session, sequence, frame[HEADER_SIZE:-2]
+
+def parse_batch(payload):
+    batch, source, count = struct.unpack(BATCH_FORMAT, payload[:BATCH_HEADER_SIZE])
+    if source >= len(BATCH_SOURCES):
+        raise ValueError(f"unknown batch source {source}")
+    if len(payload) != BATCH_HEADER_SIZE + count * SAMPLE_SIZE:
+        raise ValueError("sample count doesn't match the payload")
+    samples = [struct.unpack(SAMPLE_FORMAT, payload[BATCH_HEADER_SIZE + index * SAMPLE_SIZE:
+                                                    BATCH_HEADER_SIZE + (index + 1) * SAMPLE_SIZE])
+               for index in range(count)]
+    return BATCH_SOURCES[source], batch, samples
+
+def handle_frame(encoded, last_frame):
+    # Returns the ack to send back, if any, and the session and sequence number of the last batch printed
+    try:
+        frame_type, session, sequence, payload = parse_frame(encoded)
+        if frame_type != FRAME_DATA:
+            raise ValueError(f"unexpected frame type {frame_type}")
+        source, batch, samples = parse_batch(payload)
+    except (ValueError, struct.error) as error:
+        statistics["bad"] += 1
+        print(f"Dropped frame: {error}")
+        return None, last_frame
+
+    # A retransmission means our ack got lost, ack it again without printing it twice. After a reboot the
+    # sequence numbers start over in a new session, those frames are new.
+    statistics["frames"] += 1
+    if (session, sequence) == last_frame:
+        statistics["duplicates"] += 1
+    else:
+        print(f"{source.capitalize()} {batch} (frame {sequence}, {len(samples)} samples)")
+        for centi_degrees, uptime_ms, status in samples:
+            value = "null" if status else f"{centi_degrees / 100:.2f}"
+            print(f"  {uptime_ms},{value}")
+        print(f"  {statistics['frames']} frames, {statistics['duplicates']} duplicates, {statistics['bad']} bad")
+    return build_frame(FRAME_ACK, session, sequence), (session, sequence)
+
+def open_port(path, baud_rate):
+    # Works for real UARTs and for the pty native_sim prints at boot
+    descriptor = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(descriptor)
+    attributes = termios.tcgetattr(descriptor)
+    attributes[4] = attributes[5] = BAUD_RATES[baud_rate]
+    termios.tcsetattr(descriptor, termios.TCSANOW, attributes)
+    return descriptor
+
+def run_receiver(path, baud_rate):
+    descriptor = open_port(path, baud_rate)
+    print(f"Serial telemetry receiver listening on {path} at {baud_rate} baud")
+
+    pending = bytearray()
+    last_frame = None
+    while True:
+        pending += os.read(descriptor, 256)
+        while b"\x00" in pending:
+            encoded, _, pending = bytes(pending).partition(b"\x00")
+            pending = bytearray(pending)
+            if not encoded:
+                continue
+            ack, last_frame = handle_frame(encoded, last_frame)
+            if ack:
+                os.write(descriptor, ack)
+
+def self_test():
+    # Round trip through the same encoding the device uses, zeros and long runs included
+    for payload in (b"", b"\x00", b"\x00\x00", bytes(range(1, 255)), bytes(300), bytes(range(256)) * 2):
+        assert cobs_decode(cobs_encode(payload)) == payload
+    assert crc16_ccitt(b"123456789", 0) == 0x2189
+
+    samples = struct.pack(SAMPLE_FORMAT, -5, 1000, 0) + struct.pack(SAMPLE_FORMAT, 2150, 2000, 1)
+    frame = build_frame(FRAME_DATA, 0x1234, 7, struct.pack(BATCH_FORMAT, 42, 1, 2) + samples)
+    assert b"\x00" not in frame[1:-1]
+    ack, last_frame = handle_frame(frame[1:-1], None)
+    assert last_frame == (0x1234, 7) and parse_frame(ack[1:-1]) == (FRAME_ACK, 0x1234, 7, b"")
+
+    # A retransmission is a duplicate, the same sequence number after a reboot isn't
+    duplicates = statistics["duplicates"]
+    assert handle_frame(frame[1:-1], last_frame)[1] == last_frame and statistics["duplicates"] == duplicates + 1
+    rebooted = build_frame(FRAME_DATA, 0x4321, 7, struct.pack(BATCH_FORMAT, 1, 2, 0))
+    assert handle_frame(rebooted[1:-1], last_frame)[1] == (0x4321, 7) and statistics["duplicates"] == duplicates + 1
+
+    # A flipped bit must be caught
+    corrupted = bytearray(frame[1:-1])
+    corrupted[5] ^= 0x01
+    assert handle_frame(bytes(corrupted), None) == (None, None)
+    print("Self test passed")
+
+if __name__ == "__main__":
+    # Usage: python receiver.py <serial device or pty> [baud rate]
+    #        python receiver.py --self-test
+    if len(sys.argv) > 1 and sys.argv[1] == "--self-test":
+        self_test()
+    elif len(sys.argv) > 1:
+        run_receiver(sys.argv[1], int(sys.argv[2]) if len(sys.argv) > 2 else 115200)
+    else:
+        print("Usage: python receiver.py <serial device or pty> [baud rate] | --self-test")
+        sys.exit(1)
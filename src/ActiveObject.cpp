@@ -0,0 +1,204 @@
+// Lib C includes
+#include <errno.h>
+#include <string.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(ActiveObject);
+
+// User C++ class headers
+#include "ActiveObject.h"
+
+// Stacks of the shared work queues
+K_THREAD_STACK_DEFINE(activeObjectHighStack, ACTIVE_OBJECT_HIGH_STACK_SIZE);
+K_THREAD_STACK_DEFINE(activeObjectNormalStack, ACTIVE_OBJECT_NORMAL_STACK_SIZE);
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+K_THREAD_STACK_DEFINE(activeObjectTestStack, ACTIVE_OBJECT_TEST_STACK_SIZE);
+#endif
+
+// Define the static members
+ActiveObject *ActiveObject::objects[ACTIVE_OBJECT_MAX_OBJECTS];
+uint32_t ActiveObject::objectCount = 0;
+
+ActiveObject::ActiveObject(const char *name, active_object_priority_t priority) {
+  this->objectName = name;
+  this->queue = ActiveObject::queueOf(priority);
+
+  k_msgq_init(&this->events, this->eventsBuffer, sizeof(struct queuedEvent), ACTIVE_OBJECT_QUEUE_SIZE);
+  this->resetMetrics();
+
+  this->eventWork.owner = this;
+  k_work_init(&this->eventWork.work, ActiveObject::eventWorkHandler);
+  this->timerWork.owner = this;
+  k_work_init_delayable(&this->timerWork.work, ActiveObject::timerWorkHandler);
+
+  // Objects are created by static constructors, before any thread can publish
+  if (ActiveObject::objectCount < ACTIVE_OBJECT_MAX_OBJECTS) {
+    ActiveObject::objects[ActiveObject::objectCount++] = this;
+  } else {
+    LOG_ERR("Too many active objects, <%s> won't receive events\r\n", name);
+  }
+}
+
+ActiveObject::~ActiveObject() {
+}
+
+void ActiveObject::on(event_id_t id, std::function<void(const event_t &event)> handler) {
+  if (id < EVENT_MAX_VALUE) {
+    this->handlers[id] = handler;
+  }
+}
+
+void ActiveObject::onTimeout(std::function<void()> handler) {
+  this->timeoutHandler = handler;
+}
+
+int ActiveObject::post(const event_t &event, k_timeout_t timeout) {
+  int ret = 0;
+  uint32_t depth = 0;
+  uint32_t highWater = 0;
+  struct queuedEvent queued = {.event = event, .postedAt = k_cycle_get_32()};
+
+  // A full queue holds the publisher back rather than losing the event, unless it can't wait
+  if (k_is_in_isr()) {
+    timeout = K_NO_WAIT;
+  }
+
+  ret = k_msgq_put(&this->events, &queued, timeout);
+  if (ret < 0) {
+    this->droppedCount.fetch_add(1, std::memory_order_relaxed);
+    LOG_WRN("Queue of <%s> is full, <%s> is lost\r\n", this->objectName, EVENT_ID_TO_STRING(event.id));
+    return ret;
+  }
+
+  // Several publishers may race here, the highest depth wins
+  depth = k_msgq_num_used_get(&this->events);
+  highWater = this->queueHighWater.load(std::memory_order_relaxed);
+  while ((depth > highWater) &&
+         !this->queueHighWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed)) {
+  }
+
+  // Submitting an already queued work item is harmless, it drains the whole queue anyway
+  k_work_submit_to_queue(this->queue, &this->eventWork.work);
+
+  return 0;
+}
+
+void ActiveObject::schedule(k_timeout_t timeout) {
+  k_work_reschedule_for_queue(this->queue, &this->timerWork.work, timeout);
+}
+
+void ActiveObject::cancel() {
+  k_work_cancel_delayable(&this->timerWork.work);
+}
+
+const char *ActiveObject::name() const {
+  return this->objectName;
+}
+
+active_object_metrics_t ActiveObject::metrics() const {
+  active_object_metrics_t metrics;
+
+  // A snapshot, counters may move while it's taken
+  metrics.handled = this->handledCount;
+  metrics.dropped = this->droppedCount.load(std::memory_order_relaxed);
+  metrics.queueHighWater = this->queueHighWater.load(std::memory_order_relaxed);
+  metrics.latency = this->latency;
+  metrics.runTime = this->runTime;
+
+  return metrics;
+}
+
+void ActiveObject::resetMetrics() {
+  this->droppedCount.store(0, std::memory_order_relaxed);
+  this->queueHighWater.store(0, std::memory_order_relaxed);
+  this->handledCount = 0;
+  memset(&this->latency, 0, sizeof(this->latency));
+  memset(&this->runTime, 0, sizeof(this->runTime));
+}
+
+int ActiveObject::dispatch(const event_t &event, k_timeout_t timeout) {
+  int ret = 0;
+
+  if (event.id >= EVENT_MAX_VALUE) {
+    return -EINVAL;
+  }
+
+  // Only the objects that handle the event pay for it, each one gets its own copy exactly once
+  for (uint32_t index = 0; index < ActiveObject::objectCount; index++) {
+    if (ActiveObject::objects[index]->handlers[event.id] &&
+        (ActiveObject::objects[index]->post(event, timeout) < 0)) {
+      ret = -ENOBUFS;
+    }
+  }
+
+  return ret;
+}
+
+uint32_t ActiveObject::count() {
+  return ActiveObject::objectCount;
+}
+
+ActiveObject *ActiveObject::at(uint32_t index) {
+  return (index < ActiveObject::objectCount) ? ActiveObject::objects[index] : nullptr;
+}
+
+void ActiveObject::eventWorkHandler(struct k_work *work) {
+  struct queuedEvent queued;
+  uint32_t start = 0;
+  ActiveObject *object = CONTAINER_OF(work, struct eventWorkItem, work)->owner;
+
+  // Run to completion, one event after the other
+  while (k_msgq_get(&object->events, &queued, K_NO_WAIT) == 0) {
+    LOG_DBG("<%s> handles <%s>\r\n", object->objectName, EVENT_ID_TO_STRING(queued.event.id));
+
+    start = k_cycle_get_32();
+    eventHistogramAdd(&object->latency, k_cyc_to_us_floor32(start - queued.postedAt));
+    object->handlers[queued.event.id](queued.event);
+    eventHistogramAdd(&object->runTime, k_cyc_to_us_floor32(k_cycle_get_32() - start));
+    object->handledCount++;
+  }
+}
+
+void ActiveObject::timerWorkHandler(struct k_work *work) {
+  struct k_work_delayable *delayable = k_work_delayable_from_work(work);
+  ActiveObject *object = CONTAINER_OF(delayable, struct timerWorkItem, work)->owner;
+
+  if (object->timeoutHandler) {
+    object->timeoutHandler();
+  }
+}
+
+struct k_work_q *ActiveObject::queueOf(active_object_priority_t priority) {
+  static struct k_work_q queues[ACTIVE_OBJECT_PRIORITY_COUNT];
+  static bool started[ACTIVE_OBJECT_PRIORITY_COUNT];
+  struct k_work_queue_config config = {.name = NULL, .no_yield = false};
+
+  if (priority >= ACTIVE_OBJECT_PRIORITY_COUNT) {
+    priority = ACTIVE_OBJECT_PRIORITY_NORMAL;
+  }
+
+  // Started by the first object that needs it, objects and other users are only created by static constructors
+  if (!started[priority]) {
+    k_work_queue_init(&queues[priority]);
+    if (priority == ACTIVE_OBJECT_PRIORITY_HIGH) {
+      config.name = "activeObjectHigh";
+      k_work_queue_start(&queues[priority], activeObjectHighStack, K_THREAD_STACK_SIZEOF(activeObjectHighStack),
+                         ACTIVE_OBJECT_HIGH_THREAD_PRIORITY, &config);
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+    } else if (priority == ACTIVE_OBJECT_PRIORITY_TEST) {
+      config.name = "activeObjectTest";
+      k_work_queue_start(&queues[priority], activeObjectTestStack, K_THREAD_STACK_SIZEOF(activeObjectTestStack),
+                         ACTIVE_OBJECT_TEST_THREAD_PRIORITY, &config);
+#endif
+    } else {
+      config.name = "activeObjectNormal";
+      k_work_queue_start(&queues[priority], activeObjectNormalStack, K_THREAD_STACK_SIZEOF(activeObjectNormalStack),
+                         ACTIVE_OBJECT_NORMAL_THREAD_PRIORITY, &config);
+    }
+    started[priority] = true;
+  }
+
+  return &queues[priority];
+}
@@ -1,141 +1,440 @@
+// Lib C includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lib C++ includes
+#include <atomic>
+#include <functional>
+
 // Zephyr includes
 #include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/device.h>
 #include <zephyr/zbus/zbus.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(AppSensorDataConsumer);
 
 // User C++ class headers
+#include "ActiveObject.h"
 #include "EventManager.h"
-#include "Storage.h"
+#include "SensorDataBuffer.h"
+#include "SampleBlock.h"
+#include "SpscRingBuffer.h"
 #include "HttpClient.h"
+#include "CoapClient.h"
+#include "SerialUplink.h"
+#include "Network.h"
 
-// Function declaration of thread handlers
-static void sensorDataConsumerThreadHandler();
+// Transports the sensor data can be uploaded with
+typedef enum {
+  SENSOR_DATA_UPLINK_HTTP = 0,
+  SENSOR_DATA_UPLINK_COAP,
+  SENSOR_DATA_UPLINK_SERIAL,
+} sensor_data_uplink_t;
 
-// ZBUS subscribers definition
-ZBUS_SUBSCRIBER_DEFINE(sensorDataConsumerSubscriber, 4);
+// Transport used to upload the sensor data, serial is the wired fallback for sites without Ethernet
+static constexpr sensor_data_uplink_t SENSOR_DATA_UPLINK = SENSOR_DATA_UPLINK_HTTP;
 
-// Add a subscriber observer to ZBUS events channel
-ZBUS_CHAN_ADD_OBS(eventsChannel, sensorDataConsumerSubscriber, 4);
+// Batches uploaded at the same time, the next one fills while the previous ones are in flight
+static constexpr uint32_t SENSOR_DATA_BATCH_COUNT = 2;
 
-// Thread definition
-K_THREAD_DEFINE(sensorDataConsumerThread, 4096, sensorDataConsumerThreadHandler, NULL, NULL, NULL, 7, 0, 0);
+// Blocks waiting for a free batch slot, whatever doesn't fit goes through SensorDataBuffer instead
+static constexpr uint32_t SENSOR_DATA_INBOX_SIZE = 4;
 
-static void sensorDataConsumerThreadHandler() {
-  int ret = 0;
+// Room needed in the body for the longest entry: separator and a 10 digit timestamp, longer than any reading
+static constexpr uint32_t SENSOR_DATA_JSON_READING_SIZE = sizeof(",4294967295");
+static_assert(SENSOR_DATA_JSON_READING_SIZE >= sizeof(",-327.68"), "A reading must fit in the room of an entry");
 
-  // Initialize local variable to hold the event
-  event_t event = {.id = EVENT_INITIAL_VALUE};
-
-  // Used to figure out on which channel the event came from
-  const struct zbus_channel *channel = NULL;
-
-  // Variables to hold temperature reading in Celsius
-  char temperatureString[6] = {0};
-  char jsonArray[128] = {0};
-  int jsonStringOffset = 0;
-  uint16_t readingID = 0;
-
-  // Get the Storage instance
-  Storage& storage = Storage::getInstance();
-
-  // Create an HTTP client as a local object
-  HttpClient client((char *)"192.168.43.145", 1880);
-
-  while (true) {
-
-    // Wait forever for an event
-    ret = zbus_sub_wait(&sensorDataConsumerSubscriber, &channel, K_FOREVER);
-
-    // Check if notification is received
-    if (ret == 0) {
-
-      // Make sure the event came on the right channel
-      if (&eventsChannel == channel) {
-
-        // Read the event
-        ret = zbus_chan_read(&eventsChannel, &event, K_NO_WAIT);
-
-        if (ret == 0) {
-
-          LOG_DBG("Subscriber <%s> received event <%s> on <%s>\r\n",
-                  sensorDataConsumerSubscriber.name,
-                  EVENT_ID_TO_STRING(event.id),
-                  channel->name);
-
-          // Make sure the event is the one we are interested in
-          switch (event.id) {
-
-            case EVENT_SENSOR_DATA_SAVED: {
-              LOG_INF("Started sending sensor data to cloud");
-
-              // Read 8 temperature strings from storage and append them to the JSON string
-              // The final JSON string should be something like the following:
-              // {"temperature":[20.4, 20.32, 21.9, 22.51, 21.33, 20.65, 21.78, 20.8]}
-              jsonStringOffset = 0;
-              jsonStringOffset += snprintf(jsonArray + jsonStringOffset,
-                                           sizeof(jsonArray) - jsonStringOffset,
-                                           "{\"temperature\":[");
-              for (readingID = 0; readingID < 8; readingID++) {
-                ret = storage.read(readingID, temperatureString, sizeof(temperatureString));
-                if (ret < 0) {
-                  LOG_ERR("Failed to read temperature reading (id=%d) from storage\r\n", readingID);
-                  break;
-                }
-                LOG_INF("Read temperatureReading %d: %s °C", readingID, temperatureString);
-                jsonStringOffset += snprintf(jsonArray + jsonStringOffset,
-                                             sizeof(jsonArray) - jsonStringOffset,
-                                             "%s%s",
-                                             temperatureString,
-                                             (readingID < 7)?",":"");
-                k_msleep(1000);
-              }
-              jsonStringOffset += snprintf(jsonArray + jsonStringOffset,
-                                           sizeof(jsonArray) - jsonStringOffset,
-                                           "]}");
-              LOG_INF("jsonArray: %s", jsonArray);
-
-              // Send the readings to the HTTP server
-              client.post("/data", jsonArray, jsonStringOffset, [](uint8_t *response, uint32_t length) {
-                size_t index = 0;
-                event_t event = {.id = EVENT_SENSOR_DATA_SENT};
-
-                // Skip headers by looking for the start of the response body: '{'
-                for (index = 0; index < length; index++) {
-                  if (response[index] == '{') {
-                    break;
-                  }
-                }
-                printk("\r\nResponse(%d bytes): %.*s\r\n", length-index, length-index, &response[index]);
-
-                // Publish the <EVENT_SENSOR_DATA_SENT> event on <eventsChannel>
-                zbus_chan_pub(&eventsChannel, &event, K_NO_WAIT);
-              });
-
-              break;
-            }
-
-            default: {
-              // I'm not interested in this event
-              LOG_DBG("<%s> is not interested in this event: <%s>",
-                      sensorDataConsumerSubscriber.name,
-                      EVENT_ID_TO_STRING(event.id));
-              break;
-            }
-          }
+// Life cycle of a batch buffer
+typedef enum {
+  BATCH_FREE = 0,
+  BATCH_IN_FLIGHT,
+  BATCH_SENT,
+  BATCH_FAILED,
+} batch_state_t;
+
+// Batch buffers, only the consumer thread fills them and only while they're free
+static sensor_data_batch_t batches[SENSOR_DATA_BATCH_COUNT];
+
+// Block a batch slot uploads in place of its buffer, held until the batch is settled
+static SampleBlock *batchBlocks[SENSOR_DATA_BATCH_COUNT];
+
+// Blocks claimed by the listener in the producer thread, taken by the consumer thread
+static SpscRingBuffer<SampleBlock *, SENSOR_DATA_INBOX_SIZE> inbox;
+
+// Set by whichever thread completes the upload, so a lost notification can't leak a buffer
+static std::atomic<batch_state_t> batchStates[SENSOR_DATA_BATCH_COUNT];
+
+// Batches read back from the backlog are acknowledged once sent instead of being requeued on failure
+static bool batchFromBacklog[SENSOR_DATA_BATCH_COUNT];
+
+// Acknowledging a backlog record acknowledges all the older ones, so only one is sent at a time
+static bool backlogInFlight = false;
+
+// The backlog is only retried on the sampler's pace while uploads fail, not in a tight loop
+static bool uplinkHealthy = true;
+
+// Sequence number of the next batch taken from the RAM ring, blocks and backlog records are numbered apart
+static uint32_t batchSequence = 0;
+
+// Function declaration of helpers
+static const sensor_data_batch_t *batchAt(uint32_t index);
+static SerialUplink &serialUplink();
+static std::function<int(uint8_t *, uint32_t)> jsonProducerOf(const sensor_data_batch_t *batch);
+static int formatSample(const sample_t &sample, const char *separator, char *text, size_t size);
+static void reapBatches(SensorDataBuffer &buffer);
+static bool fillBatch(SensorDataBuffer &buffer, uint32_t index, bool retryBacklog);
+static void uploadBatches(SensorDataBuffer &buffer, HttpClient &client, CoapClient &coapClient, bool retryBacklog);
+static void completeBatch(uint32_t index, const sensor_data_batch_t *batch, bool sent);
+
+// Function declaration of event handlers
+static void onSensorDataSaved(const event_t &event);
+static void onSensorDataSent(const event_t &event);
+static void onStorageReady(const event_t &event);
+static void onNetworkAvailable(const event_t &event);
+static void onNetworkLost(const event_t &event);
+
+// Function declaration of listener callbacks
+static void sensorDataConsumerListenerCallback(const struct zbus_channel *channel);
+
+// Function declaration of init functions
+static int sensorDataConsumerInit();
+
+// ZBUS listeners definition
+ZBUS_LISTENER_DEFINE(sensorDataConsumerListener, sensorDataConsumerListenerCallback);
+
+// Add a listener observer to ZBUS acquisition channel, the only one carrying blocks
+ZBUS_CHAN_ADD_OBS(acquisitionChannel, sensorDataConsumerListener, 3);
+
+// Active object definition, uploads may block on the network so it runs on the normal priority work queue
+static ActiveObject sensorDataConsumer("sensorDataConsumer", ACTIVE_OBJECT_PRIORITY_NORMAL);
+
+// HTTP client, uploads are queued to the HTTP request queue and reuse kept-alive connections
+static HttpClient client((char *)"192.168.43.145", 1880, true);
+
+// CoAP client, used instead of HTTP when selected as uplink
+static CoapClient coapClient((char *)"192.168.43.145", 5683);
+
+SYS_INIT(sensorDataConsumerInit, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+static int sensorDataConsumerInit() {
+  sensorDataConsumer.on(EVENT_SENSOR_DATA_SAVED, onSensorDataSaved);
+  sensorDataConsumer.on(EVENT_SENSOR_DATA_SENT, onSensorDataSent);
+  sensorDataConsumer.on(EVENT_STORAGE_READY, onStorageReady);
+  sensorDataConsumer.on(EVENT_NETWORK_AVAILABLE, onNetworkAvailable);
+  sensorDataConsumer.on(EVENT_NETWORK_LOST, onNetworkLost);
+
+  return 0;
+}
+
+static void onSensorDataSaved(const event_t &event) {
+  LOG_DBG("Block %d was acquired\r\n", event.batch);
+
+  // The listener already claimed the block if there was one, upload it with whatever is buffered
+  uploadBatches(SensorDataBuffer::getInstance(), client, coapClient, true);
+}
+
+static void onSensorDataSent(const event_t &event) {
+  LOG_DBG("An upload was settled\r\n");
+
+  // A batch buffer was freed, catch up with samples that piled up meanwhile
+  uploadBatches(SensorDataBuffer::getInstance(), client, coapClient, false);
+}
+
+static void onStorageReady(const event_t &event) {
+  LOG_DBG("Storage is mounted, %d backlog records are waiting\r\n", SensorDataBuffer::getInstance().backlogged());
+
+  // Batches left in flash before the reset can go out without waiting for new samples
+  uploadBatches(SensorDataBuffer::getInstance(), client, coapClient, true);
+}
+
+static void onNetworkAvailable(const event_t &event) {
+  LOG_INF("Network is back, resuming uploads\r\n");
+
+  // Whatever piled up in RAM and flash while the network was down
+  uploadBatches(SensorDataBuffer::getInstance(), client, coapClient, true);
+}
+
+static void onNetworkLost(const event_t &event) {
+  // Samples keep piling up in RAM then in flash, nothing is attempted until the network is back
+  LOG_WRN("Network lost, pausing uploads\r\n");
+}
+
+static void sensorDataConsumerListenerCallback(const struct zbus_channel *channel) {
+  const event_t *event = (const event_t *)zbus_chan_const_msg(channel);
+
+  // Runs in the publisher context while the block is guaranteed alive, keep it if there's room for it.
+  // Only the producer publishes blocks, so the room can't be taken between the check and the push.
+  // While the network is down the samples are better off in the buffer, which spills to flash.
+  if ((SENSOR_DATA_UPLINK != SENSOR_DATA_UPLINK_SERIAL) && !Network::getInstance().isReady()) {
+    return;
+  }
+  if ((event->id == EVENT_SENSOR_DATA_SAVED) && (event->block != nullptr) && (inbox.size() < inbox.capacity())) {
+    event->block->claim();
+    inbox.push(event->block);
+  }
+}
+
+static const sensor_data_batch_t *batchAt(uint32_t index) {
+  return (batchBlocks[index] != nullptr) ? &batchBlocks[index]->batch() : &batches[index];
+}
+
+static SerialUplink &serialUplink() {
+  // Framed telemetry on usart2, only built when it is the uplink: its rings and DMA reception cost RAM otherwise
+  static SerialUplink uplink(DEVICE_DT_GET_OR_NULL(DT_NODELABEL(usart2)));
+
+  return uplink;
+}
+
+static std::function<int(uint8_t *, uint32_t)> jsonProducerOf(const sensor_data_batch_t *batch) {
+  // Stream the batch straight into the request body
+  // The final JSON string should be something like the following:
+  // {"uptimeMs":[1000, 2000, 3000, 4000],"temperature":[20.4, 20.32, 21.9, 22.51]}
+  // Batches don't reach the server in sampling order (the backlog goes first), the timestamps put them back.
+  // The producer runs later from the HTTP request queue work so it owns its own state
+  return [batch, series = (uint32_t)0, index = (uint32_t)0, jsonOpened = false]
+         (uint8_t *data, uint32_t size) mutable -> int {
+    int offset = 0;
+    const char *closing = nullptr;
+
+    if (!jsonOpened) {
+      offset += snprintf((char *)data, size, "{\"uptimeMs\":[");
+      jsonOpened = true;
+    }
+
+    // Timestamps first, then the readings in the same order. Only start an entry when it's sure to fit,
+    // the rest goes in the next chunk
+    while (series < 2) {
+      if (index < batch->count) {
+        if ((size - offset) <= SENSOR_DATA_JSON_READING_SIZE) {
+          break;
+        }
+        if (series == 0) {
+          offset += snprintf((char *)data + offset, size - offset, "%s%u", (index > 0)?",":"",
+                             batch->samples[index].uptimeMs);
         } else {
-          // Something wrong happened while reading event from channel
-          LOG_ERR("Something wrong happened while reading from channel: %d", ret);
+          offset += formatSample(batch->samples[index], (index > 0)?",":"", (char *)data + offset, size - offset);
         }
+        index++;
+        continue;
+      }
+
+      closing = (series == 0) ? "],\"temperature\":[" : "]}";
+      if ((size - offset) <= strlen(closing)) {
+        break;
+      }
+      offset += snprintf((char *)data + offset, size - offset, "%s", closing);
+      series++;
+      index = 0;
+    }
+
+    return offset;
+  };
+}
+
+static int formatSample(const sample_t &sample, const char *separator, char *text, size_t size) {
+  int32_t centiDegrees = sample.centiDegrees;
+
+  // Readings that can't be trusted are kept in place so the series stays aligned
+  if (sample.status != SAMPLE_STATUS_OK) {
+    return snprintf(text, size, "%snull", separator);
+  }
+
+  // Fixed-point to text, the sign is printed apart so that -0.05 isn't printed as 0.05
+  return snprintf(text,
+                  size,
+                  "%s%s%d.%02d",
+                  separator,
+                  (centiDegrees < 0)?"-":"",
+                  abs(centiDegrees) / 100,
+                  abs(centiDegrees) % 100);
+}
+
+static void reapBatches(SensorDataBuffer &buffer) {
+  int ret = 0;
+
+  for (uint32_t index = 0; index < SENSOR_DATA_BATCH_COUNT; index++) {
+    batch_state_t state = batchStates[index].load(std::memory_order_acquire);
+
+    if ((state != BATCH_SENT) && (state != BATCH_FAILED)) {
+      continue;
+    }
+
+    const sensor_data_batch_t *batch = batchAt(index);
+    if (batchFromBacklog[index]) {
+      // Commit the record, or read it again on the next retry
+      if (state == BATCH_SENT) {
+        buffer.ackBacklog(batch->sequence);
       } else {
-        // I'm not interested in this channel
-        LOG_WRN("<%s> is not interested in this channel: <%s>",
-                sensorDataConsumerSubscriber.name,
-                channel->name);
+        buffer.rewindBacklog();
+      }
+      backlogInFlight = false;
+    } else if (state == BATCH_FAILED) {
+      // Keep the samples in flash until the uplink is back, they survive a reboot there
+      ret = buffer.requeue(*batch);
+      if (ret < 0) {
+        LOG_ERR("Failed to move %s %d to the backlog, %d samples are lost: %d\r\n",
+                SENSOR_DATA_BATCH_SOURCE_TO_STRING(batch->source), batch->sequence, batch->count, ret);
+      }
+    }
+    uplinkHealthy = (state == BATCH_SENT);
+
+    // Back to the pool once the last holder lets it go
+    if (batchBlocks[index] != nullptr) {
+      batchBlocks[index]->release();
+      batchBlocks[index] = nullptr;
+    }
+
+    batchStates[index].store(BATCH_FREE, std::memory_order_release);
+  }
+}
+
+static bool fillBatch(SensorDataBuffer &buffer, uint32_t index, bool retryBacklog) {
+  sensor_data_batch_t *batch = &batches[index];
+
+  // Oldest samples first: the backlog holds the batches that failed to upload, then the samples in RAM,
+  // then the blocks the producer just handed over. Samples spilled while the ring was full are newer than
+  // the ones left in RAM, every reading carries its timestamp so the server puts those back in place.
+  if (!backlogInFlight && (uplinkHealthy || retryBacklog) && (buffer.nextBacklog(batch) == 0)) {
+    batchFromBacklog[index] = true;
+    backlogInFlight = true;
+    return true;
+  }
+
+  // Whole batches only as the sampler notifies again once the next one is complete, unless the sampler
+  // spills to the backlog (the ring won't fill up again until the backlog is drained) or blocks bypass
+  // the ring (it won't fill up again at all), then whatever is left goes first
+  if ((buffer.available() >= SENSOR_DATA_BATCH_SIZE) ||
+      ((buffer.available() > 0) && ((buffer.backlogged() > 0) || !inbox.isEmpty()))) {
+    batch->sequence = batchSequence++;
+    batch->source = SENSOR_DATA_BATCH_SOURCE_RING;
+    batch->count = buffer.popMany(batch->samples, SENSOR_DATA_BATCH_SIZE);
+    batchFromBacklog[index] = false;
+    return batch->count > 0;
+  }
+
+  // Blocks handed over by the producer are uploaded in place, nothing is copied. They're newer than
+  // anything left in RAM or flash, so they wait until the backlog is drained too.
+  if ((buffer.backlogged() == 0) && inbox.pop(&batchBlocks[index])) {
+    batchFromBacklog[index] = false;
+    return true;
+  }
+
+  return false;
+}
+
+static void uploadBatches(SensorDataBuffer &buffer, HttpClient &client, CoapClient &coapClient, bool retryBacklog) {
+  int ret = 0;
+
+  // Settle the batches that completed since last time
+  reapBatches(buffer);
+
+  // No point waiting for connection timeouts, <EVENT_NETWORK_AVAILABLE> brings us back here
+  if ((SENSOR_DATA_UPLINK != SENSOR_DATA_UPLINK_SERIAL) && !Network::getInstance().isReady()) {
+    return;
+  }
+
+  for (uint32_t index = 0; index < SENSOR_DATA_BATCH_COUNT; index++) {
+
+    if (batchStates[index].load(std::memory_order_acquire) != BATCH_FREE) {
+      continue;
+    }
+    if (!fillBatch(buffer, index, retryBacklog)) {
+      return;
+    }
+
+    const sensor_data_batch_t *batch = batchAt(index);
+    batchStates[index].store(BATCH_IN_FLIGHT, std::memory_order_release);
+
+    LOG_INF("Started sending %s %d of %d samples to cloud (%d dropped, %d spilled to flash so far)\r\n",
+            SENSOR_DATA_BATCH_SOURCE_TO_STRING(batch->source),
+            batch->sequence,
+            batch->count,
+            buffer.dropped(),
+            buffer.spilled());
+
+    // Only the selected transport is compiled in, the serial uplink isn't even referenced otherwise
+    if constexpr (SENSOR_DATA_UPLINK == SENSOR_DATA_UPLINK_COAP) {
+      int64_t start = k_uptime_get();
+      uint32_t sent = coapClient.bytesSent();
+      uint32_t received = coapClient.bytesReceived();
+
+      // Confirmable POST, split in Block1 transfers when the body is larger than one block
+      ret = coapClient.postStream("data", jsonProducerOf(batch), [](uint8_t code, const uint8_t *payload, uint16_t length) {
+        printk("\r\nResponse %d.%02d: %.*s\r\n", code >> 5, code & 0x1F, length, payload);
+      });
+      if (ret < 0) {
+        LOG_ERR("Failed to send %s %d: %d\r\n", SENSOR_DATA_BATCH_SOURCE_TO_STRING(batch->source), batch->sequence, ret);
       }
+      LOG_INF("CoAP upload took %lld ms, %d bytes sent, %d bytes received\r\n",
+              k_uptime_get() - start,
+              coapClient.bytesSent() - sent,
+              coapClient.bytesReceived() - received);
+
+      // Only a 2.xx response code means the server took the data
+      completeBatch(index, batch, (ret >= 0) && ((ret >> 5) == 2));
+    } else if constexpr (SENSOR_DATA_UPLINK == SENSOR_DATA_UPLINK_SERIAL) {
+      int64_t start = k_uptime_get();
+
+      // Acknowledged by the receiver, or retransmitted until it gives up
+      ret = serialUplink().send(*batch);
+      if (ret < 0) {
+        LOG_ERR("Failed to send %s %d: %d\r\n", SENSOR_DATA_BATCH_SOURCE_TO_STRING(batch->source), batch->sequence, ret);
+      }
+      LOG_INF("Serial upload took %lld ms, %d frames sent, %d retransmitted so far\r\n",
+              k_uptime_get() - start,
+              serialUplink().stats().framesSent,
+              serialUplink().stats().retransmissions);
+
+      completeBatch(index, batch, ret == 0);
     } else {
-      // Something wrong happened while waiting for event
-      LOG_ERR("Something wrong happened while waiting for event: %d", ret);
+      // Queue the upload and go on with the next batch right away,
+      // the buffer is settled and <EVENT_SENSOR_DATA_SENT> published once it's done
+      ret = client.postStreamAsync("/data", jsonProducerOf(batch),
+                                   [index, batch, start = k_uptime_get()]
+                                   (const HttpResponse &response, const uint8_t *body, uint32_t length) {
+        // Body slices arrive as they are parsed, an empty one marks the end of the response
+        if (length > 0) {
+          printk("%.*s", length, body);
+          return;
+        }
+
+        if (response.error() == 0) {
+          printk("\r\nResponse status %d\r\n", response.status());
+        } else {
+          LOG_ERR("Failed to send %s %d: %d\r\n", SENSOR_DATA_BATCH_SOURCE_TO_STRING(batch->source), batch->sequence,
+                  response.error());
+        }
+        LOG_INF("HTTP upload took %lld ms, %d bytes sent, %d bytes received\r\n",
+                k_uptime_get() - start,
+                response.bytesSent(),
+                response.bytesReceived());
+
+        // Only a 2xx status means the server took the data
+        completeBatch(index, batch, (response.error() == 0) && ((response.status() / 100) == 2));
+      });
+      if (ret < 0) {
+        LOG_ERR("Failed to queue upload of %s %d: %d\r\n", SENSOR_DATA_BATCH_SOURCE_TO_STRING(batch->source),
+                batch->sequence, ret);
+        batchStates[index].store(BATCH_FAILED, std::memory_order_release);
+        reapBatches(buffer);
+        return;
+      }
     }
   }
 }
+
+static void completeBatch(uint32_t index, const sensor_data_batch_t *batch, bool sent) {
+  // Initialize local variable to hold the event
+  event_t event = {.id = EVENT_SENSOR_DATA_SENT, .batch = batch->sequence};
+
+  LOG_DBG("%s %d was %s\r\n", SENSOR_DATA_BATCH_SOURCE_TO_STRING(batch->source), batch->sequence,
+          sent ? "uploaded" : "not uploaded");
+
+  // The consumer thread settles the buffer, acknowledging it or moving it to the backlog
+  batchStates[index].store(sent ? BATCH_SENT : BATCH_FAILED, std::memory_order_release);
+
+  // Publish the <EVENT_SENSOR_DATA_SENT> event on <uploadChannel>
+  eventPublish(event, K_MSEC(EVENT_PUBLISH_TIMEOUT_MS));
+}
@@ -1,126 +1,137 @@
 // Zephyr includes
 #include <zephyr/kernel.h>
+#include <zephyr/init.h>
 #include <zephyr/device.h>
 #include <zephyr/zbus/zbus.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(AppSensorDataProducer);
 
 // User C++ class headers
+#include "ActiveObject.h"
 #include "EventManager.h"
 #include "Temperature.h"
-#include "Storage.h"
+#include "SensorDataBuffer.h"
+#include "SampleBlock.h"
 
-// Function declaration of thread handlers
-static void sensorDataProducerThreadHandler();
+// Sampling period of the temperature sensor
+static constexpr int64_t SENSOR_DATA_SAMPLING_PERIOD_MS = 1000;
 
-// ZBUS subscribers definition
-ZBUS_SUBSCRIBER_DEFINE(sensorDataProducerSubscriber, 4);
+// Function declaration of helpers
+static void startSampling(const event_t &event);
+static void onNetworkAvailable(const event_t &event);
+static void takeSample();
+static void bufferSample(SensorDataBuffer &buffer, const sample_t &sample);
 
-// Add a subscriber observer to ZBUS events channel
-ZBUS_CHAN_ADD_OBS(eventsChannel, sensorDataProducerSubscriber, 4);
+// Function declaration of init functions
+static int sensorDataProducerInit();
 
-// Thread definition
-K_THREAD_DEFINE(sensorDataProducerThread, 1024, sensorDataProducerThreadHandler, NULL, NULL, NULL, 7, 0, 0);
+// Active object definition, sampling is time critical so it runs on the high priority work queue
+static ActiveObject sensorDataProducer("sensorDataProducer", ACTIVE_OBJECT_PRIORITY_HIGH);
 
-static void sensorDataProducerThreadHandler() {
-  int ret = 0;
-
-  // Initialize local variable to hold the event
-  event_t event = {.id = EVENT_INITIAL_VALUE};
-
-  // Used to figure out on which channel the event came from
-  const struct zbus_channel *channel = NULL;
-
-  // Variable to hold temperature reading in Celsius
-  double temperatureDouble = 0;
-  char temperatureString[6] = {0};
-
-  // Reference die temperature device from device tree
-  const struct device *temperatureDevice = DEVICE_DT_GET(DT_NODELABEL(die_temp));
+// Die temperature device from device tree
+static Temperature temperature(DEVICE_DT_GET_OR_NULL(DT_NODELABEL(die_temp)));
 
-  // Create local object using the device
-  Temperature temperature(temperatureDevice);
+// Sampling starts with the first acquisition event and then never waits for the uploader
+static bool sampling = false;
+static int64_t nextSampleTime = 0;
+static uint32_t sampleCount = 0;
 
-  // Get the Storage instance
-  Storage& storage = Storage::getInstance();
+// Block the current batch is collected in, if the pool had one
+static SampleBlock *block = nullptr;
 
-  while (true) {
+SYS_INIT(sensorDataProducerInit, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
 
-    // Wait forever for an event
-    ret = zbus_sub_wait(&sensorDataProducerSubscriber, &channel, K_FOREVER);
+static int sensorDataProducerInit() {
+  sensorDataProducer.on(EVENT_NETWORK_AVAILABLE, onNetworkAvailable);
+  sensorDataProducer.on(EVENT_START_SENSOR_DATA_ACQUISITION, startSampling);
+  sensorDataProducer.onTimeout(takeSample);
 
-    // Check if notification is received
-    if (ret == 0) {
-
-      // Make sure the event came on the right channel
-      if (&eventsChannel == channel) {
+  return 0;
+}
 
-        // Read the event
-        ret = zbus_chan_read(&eventsChannel, &event, K_NO_WAIT);
+static void startSampling(const event_t &event) {
+  if (!sampling) {
+    LOG_INF("Started acquiring sensor data every %lld ms\r\n", SENSOR_DATA_SAMPLING_PERIOD_MS);
+    sampling = true;
+    nextSampleTime = k_uptime_get();
+    sensorDataProducer.schedule(K_TIMEOUT_ABS_MS(nextSampleTime));
+  }
+}
 
-        if (ret == 0) {
+static void onNetworkAvailable(const event_t &event) {
+  int ret = 0;
 
-          LOG_DBG("Subscriber <%s> received event <%s> on <%s>\r\n",
-                  sensorDataProducerSubscriber.name,
-                  EVENT_ID_TO_STRING(event.id),
-                  channel->name);
+  startSampling(event);
 
-          // Make sure the event is the one we are interested in
-          switch (event.id) {
+  // Blocks go straight to the uploader from now on, so a partly filled spill record would sit in RAM
+  // until the next outage, and be lost on a reset meanwhile
+  ret = SensorDataBuffer::getInstance().flushSpill();
+  if (ret < 0) {
+    LOG_WRN("Failed to flush spilled samples: %d\r\n", ret);
+  }
+}
 
-            case EVENT_NETWORK_AVAILABLE:
-            case EVENT_START_SENSOR_DATA_ACQUISITION:
-            case EVENT_SENSOR_DATA_SENT: {
-              LOG_INF("Started acquiring sensor data and saving it to storage");
+static void takeSample() {
+  int ret = 0;
 
-              // Take 8 readings and save them in storage
-              for (uint16_t readingID = 0; readingID < 8; readingID++) {
+  // Initialize local variable to hold the event
+  event_t event = {.id = EVENT_INITIAL_VALUE};
 
-                // Read temperature as a double
-                temperatureDouble = temperature.read();
-                LOG_INF("Saved temperatureDouble %d: %.1f °C", readingID, temperatureDouble);
+  // Variable to hold the fixed-point temperature reading, when it was taken and its status
+  sample_t sample = {0};
 
-                // Convert temperature to a string
-                ret = snprintf(temperatureString, sizeof(temperatureString), "%.2f", temperatureDouble);
-                LOG_INF("Saved temperatureString %d: %.*s °C", readingID, sizeof(temperatureString), temperatureString);
+  // Get the SensorDataBuffer instance shared with the uploader
+  SensorDataBuffer& buffer = SensorDataBuffer::getInstance();
 
-                // Save reading in storage
-                ret = storage.write(readingID, &temperatureString, sizeof(temperatureString));
-                if (ret < 0) {
-                  LOG_ERR("Failed to save temperature reading (id=%d) in storage\r\n", readingID);
-                  break;
-                }
-                k_msleep(1000);
-              }
+  // A failed reading is still buffered, its status flags travel with it up to the uplink
+  ret = temperature.read(&sample);
+  if (ret < 0) {
+    LOG_WRN("Failed to read temperature: %d\r\n", ret);
+  }
 
-              // Publish the <EVENT_SENSOR_DATA_SAVED> event on <eventsChannel>
-              event.id = EVENT_SENSOR_DATA_SAVED;
-              zbus_chan_pub(&eventsChannel, &event, K_NO_WAIT);
+  // Absolute deadlines, so the period doesn't drift with the time spent here
+  nextSampleTime += SENSOR_DATA_SAMPLING_PERIOD_MS;
+  sensorDataProducer.schedule(K_TIMEOUT_ABS_MS(nextSampleTime));
 
-              break;
-            }
+  // Each batch goes in a pooled block handed over by pointer, or through the buffer when the pool is empty
+  if ((sampleCount % SENSOR_DATA_BATCH_SIZE) == 0) {
+    block = SampleBlock::allocate(sampleCount / SENSOR_DATA_BATCH_SIZE);
+  }
+  if (block != nullptr) {
+    block->append(sample);
+  } else {
+    bufferSample(buffer, sample);
+  }
 
-            default: {
-              // I'm not interested in this event
-              LOG_DBG("<%s> is not interested in this event: <%s>",
-                      sensorDataProducerSubscriber.name,
-                      EVENT_ID_TO_STRING(event.id));
-              break;
-            }
-          }
-        } else {
-          // Something wrong happened while reading event from channel
-          LOG_ERR("Something wrong happened while reading from channel: %d", ret);
+  // Publish the <EVENT_SENSOR_DATA_SAVED> event on <acquisitionChannel> once per batch
+  sampleCount++;
+  if ((sampleCount % SENSOR_DATA_BATCH_SIZE) == 0) {
+    event.id = EVENT_SENSOR_DATA_SAVED;
+    event.batch = (sampleCount / SENSOR_DATA_BATCH_SIZE) - 1;
+    event.block = block;
+    eventPublish(event, K_MSEC(EVENT_PUBLISH_TIMEOUT_MS));
+
+    if (block != nullptr) {
+      // No listener took the block, its samples go through the buffer like the others
+      if (!block->claimed()) {
+        for (uint32_t index = 0; index < block->batch().count; index++) {
+          bufferSample(buffer, block->batch().samples[index]);
         }
-      } else {
-        // I'm not interested in this channel
-        LOG_WRN("<%s> is not interested in this channel: <%s>",
-                sensorDataProducerSubscriber.name,
-                channel->name);
       }
-    } else {
-      // Something wrong happened while waiting for event
-      LOG_ERR("Something wrong happened while waiting for event: %d", ret);
+      block->release();
+      block = nullptr;
     }
   }
 }
+
+static void bufferSample(SensorDataBuffer &buffer, const sample_t &sample) {
+  int ret = 0;
+
+  // Hand the sample over to the uploader, this never waits for it, nor for flash when the sample spills
+  ret = buffer.push(sample);
+  if (ret < 0) {
+    LOG_WRN("Dropped temperature sample taken at %u ms: %d\r\n", sample.uptimeMs, ret);
+  } else {
+    LOG_DBG("Buffered temperature sample of %d hundredths of °C\r\n", sample.centiDegrees);
+  }
+}
@@ -0,0 +1,191 @@
+// Lib C includes
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+// Zephyr includes
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(BatchRecord);
+
+// User C++ class headers
+#include "BatchRecord.h"
+#include "SampleCodec.h"
+
+BatchRecord::BatchRecord() {
+  this->begin(0);
+}
+
+BatchRecord::~BatchRecord() {
+  // Destructor is automatically called when the object goes out of scope or is explicitly deleted
+}
+
+void BatchRecord::begin(uint32_t sequence) {
+  this->record.header.sequence = sequence;
+  this->record.header.count = 0;
+  this->record.header.encoding = BATCH_RECORD_ENCODING_RAW;
+  this->record.header.crc = 0;
+  this->cursor = 0;
+}
+
+bool BatchRecord::append(const sample_t &sample) {
+  if (this->isFull()) {
+    return false;
+  }
+
+  this->record.samples[this->record.header.count++] = sample;
+
+  return true;
+}
+
+void BatchRecord::seal() {
+  this->record.header.encoding = BATCH_RECORD_ENCODING_RAW;
+  this->record.header.crc = this->checksum();
+}
+
+int BatchRecord::load(size_t length) {
+  this->cursor = 0;
+
+  // The length read from storage has to match the count announced in the header
+  if ((length < sizeof(batch_record_header_t)) ||
+      (this->record.header.count > BATCH_RECORD_MAX_SAMPLES) ||
+      (length != this->size())) {
+    LOG_ERR("Batch record has an invalid length: %d\r\n", (int)length);
+    this->record.header.count = 0;
+    return -EBADMSG;
+  }
+
+  if ((this->record.header.encoding != BATCH_RECORD_ENCODING_RAW) || (this->record.header.crc != this->checksum())) {
+    LOG_ERR("Batch record %d is corrupted\r\n", this->record.header.sequence);
+    this->record.header.count = 0;
+    return -EBADMSG;
+  }
+
+  return 0;
+}
+
+void BatchRecord::rewind() {
+  this->cursor = 0;
+}
+
+bool BatchRecord::next(sample_t *sample) {
+  if (this->cursor >= this->record.header.count) {
+    return false;
+  }
+
+  *sample = this->record.samples[this->cursor++];
+
+  return true;
+}
+
+uint16_t BatchRecord::remaining() const {
+  return this->record.header.count - this->cursor;
+}
+
+uint32_t BatchRecord::sequence() const {
+  return this->record.header.sequence;
+}
+
+uint16_t BatchRecord::count() const {
+  return this->record.header.count;
+}
+
+bool BatchRecord::isEmpty() const {
+  return this->record.header.count == 0;
+}
+
+bool BatchRecord::isFull() const {
+  return this->record.header.count >= BATCH_RECORD_MAX_SAMPLES;
+}
+
+void *BatchRecord::data() {
+  return &this->record;
+}
+
+size_t BatchRecord::size() const {
+  return sizeof(batch_record_header_t) + (this->record.header.count * sizeof(sample_t));
+}
+
+size_t BatchRecord::encode(uint8_t *buffer, size_t capacity) {
+  SampleCodec codec;
+  batch_record_header_t header = this->record.header;
+  uint8_t *payload = buffer + sizeof(batch_record_header_t);
+  bool compressed = BATCH_RECORD_COMPRESSION_ENABLED && (capacity > sizeof(batch_record_header_t));
+
+  // Compressed unless a sample doesn't fit in what the raw record would take
+  if (compressed) {
+    codec.beginEncode(payload, MIN(capacity, this->size()) - sizeof(batch_record_header_t));
+    for (uint16_t index = 0; compressed && (index < header.count); index++) {
+      compressed = codec.encode(this->record.samples[index]);
+    }
+  }
+
+  if (compressed) {
+    header.encoding = BATCH_RECORD_ENCODING_DELTA;
+    header.crc = checksumOf(header, payload, codec.encodedSize());
+    memcpy(buffer, &header, sizeof(header));
+    return sizeof(header) + codec.encodedSize();
+  }
+
+  if (capacity < this->size()) {
+    return 0;
+  }
+  this->seal();
+  memcpy(buffer, &this->record, this->size());
+
+  return this->size();
+}
+
+int BatchRecord::decode(const uint8_t *buffer, size_t length) {
+  SampleCodec codec;
+  const uint8_t *payload = buffer + sizeof(batch_record_header_t);
+
+  this->begin(0);
+  if (length < sizeof(batch_record_header_t)) {
+    LOG_ERR("Batch record has an invalid length: %d\r\n", (int)length);
+    return -EBADMSG;
+  }
+  memcpy(&this->record.header, buffer, sizeof(batch_record_header_t));
+
+  if (this->record.header.encoding == BATCH_RECORD_ENCODING_RAW) {
+    memcpy(&this->record, buffer, MIN(length, sizeof(this->record)));
+    return this->load(length);
+  }
+
+  if ((this->record.header.encoding != BATCH_RECORD_ENCODING_DELTA) ||
+      (this->record.header.count > BATCH_RECORD_MAX_SAMPLES) ||
+      (this->record.header.crc != checksumOf(this->record.header, payload, length - sizeof(batch_record_header_t)))) {
+    LOG_ERR("Batch record %d is corrupted\r\n", this->record.header.sequence);
+    this->record.header.count = 0;
+    return -EBADMSG;
+  }
+
+  // Back to raw samples in RAM, the cursor walks them as usual
+  codec.beginDecode(payload, length - sizeof(batch_record_header_t));
+  for (uint16_t index = 0; index < this->record.header.count; index++) {
+    if (!codec.decode(&this->record.samples[index])) {
+      LOG_ERR("Batch record %d is truncated\r\n", this->record.header.sequence);
+      this->record.header.count = 0;
+      return -EBADMSG;
+    }
+  }
+
+  return 0;
+}
+
+uint16_t BatchRecord::checksum() const {
+  // Everything but the CRC itself, only the samples in use
+  return checksumOf(this->record.header,
+                    (const uint8_t *)this->record.samples,
+                    this->record.header.count * sizeof(sample_t));
+}
+
+uint16_t BatchRecord::checksumOf(const batch_record_header_t &header, const uint8_t *payload, size_t length) {
+  uint16_t crc = 0xFFFF;
+
+  crc = crc16_ccitt(crc, (const uint8_t *)&header, offsetof(batch_record_header_t, crc));
+  crc = crc16_ccitt(crc, payload, length);
+
+  return crc;
+}
@@ -0,0 +1,556 @@
+// Lib C includes
+#include <string.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/random/random.h>
+#include <zephyr/net/net_ip.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(CoapClient);
+
+// User C++ class headers
+#include "CoapClient.h"
+
+CoapClient::CoapClient(char *server, uint16_t port) {
+  // 1. Initialize attributes
+  this->sock = -1;
+  this->server = server;
+  this->port = port;
+  this->tokenLength = 0;
+  this->observing = false;
+  this->observeTokenLength = 0;
+  this->sentBytes = 0;
+  this->receivedBytes = 0;
+  this->roundTripMs = -1;
+
+  // 2. Build the server address once, it doesn't change between requests
+  memset((void *)&this->socketAddress, 0, sizeof(this->socketAddress));
+  net_sin(&this->socketAddress)->sin_family = AF_INET;
+  net_sin(&this->socketAddress)->sin_port = htons(port);
+  inet_pton(AF_INET, server, &net_sin(&this->socketAddress)->sin_addr);
+}
+
+CoapClient::~CoapClient() {
+  if (this->sock >= 0) {
+    close(this->sock);
+  }
+}
+
+int CoapClient::post(const char *path,
+                     const uint8_t *data,
+                     uint32_t length,
+                     std::function<void(uint8_t, const uint8_t *, uint16_t)> callback) {
+  int ret = 0;
+  uint32_t offset = 0;
+  uint32_t number = 0;
+  uint16_t blockBytes = COAP_CLIENT_BLOCK_BYTES;
+  uint16_t size = 0;
+
+  // Small bodies go in a single confirmable message, larger ones are split in Block1 transfers
+  do {
+    size = ((length - offset) > blockBytes) ? blockBytes : (length - offset);
+    ret = this->sendBlock(path,
+                          number,
+                          (offset + size) < length,
+                          &data[offset],
+                          size,
+                          callback);
+    if (ret < 0) {
+      return ret;
+    }
+    offset += size;
+    number++;
+  } while (offset < length);
+
+  return ret;
+}
+
+int CoapClient::postStream(const char *path,
+                           std::function<int(uint8_t *, uint32_t)> producer,
+                           std::function<void(uint8_t, const uint8_t *, uint16_t)> callback) {
+  int ret = 0;
+  uint32_t fill = 0;
+  uint32_t number = 0;
+  bool done = false;
+  bool more = false;
+  uint16_t blockBytes = COAP_CLIENT_BLOCK_BYTES;
+
+  // One block plus look-ahead, to know whether the block being sent is the last one
+  uint8_t staging[2 * COAP_CLIENT_BLOCK_BYTES];
+
+  if (producer == nullptr) {
+    LOG_ERR("Failed to register producer\r\n");
+    return -EINVAL;
+  }
+
+  do {
+    // 1. Pull from the producer until there is more than one block or the body ends
+    while (!done && (fill <= blockBytes)) {
+      ret = producer(&staging[fill], sizeof(staging) - fill);
+      if (ret < 0) {
+        LOG_ERR("Body producer failed (%d)\r\n", ret);
+        return ret;
+      }
+      if (ret == 0) {
+        done = true;
+      }
+      fill += ret;
+    }
+
+    // 2. Send one block, the look-ahead byte tells if more follow
+    more = fill > blockBytes;
+    ret = this->sendBlock(path, number, more, staging, more ? blockBytes : fill, callback);
+    if (ret < 0) {
+      return ret;
+    }
+
+    // 3. Shift what's left to the front of the staging buffer
+    if (more) {
+      memmove(staging, &staging[blockBytes], fill - blockBytes);
+      fill -= blockBytes;
+    }
+    number++;
+  } while (more);
+
+  return ret;
+}
+
+int CoapClient::observe(const char *path, std::function<void(uint8_t, const uint8_t *, uint16_t)> callback) {
+  int ret = 0;
+  uint16_t length = 0;
+  const uint8_t *payload = nullptr;
+  struct coap_packet request;
+  struct coap_packet response;
+
+  if ((path == nullptr) || (strlen(path) >= sizeof(this->observePath))) {
+    LOG_ERR("Invalid observe path\r\n");
+    return -EINVAL;
+  }
+
+  if (callback == nullptr) {
+    LOG_ERR("Failed to register callback\r\n");
+    return -EINVAL;
+  }
+
+  // 1. GET with Observe=0 registers us as an observer of the resource
+  ret = this->initRequest(&request, COAP_TYPE_CON, COAP_METHOD_GET, nullptr, 0);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = coap_append_option_int(&request, COAP_OPTION_OBSERVE, 0);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = this->appendPath(&request, path);
+  if (ret < 0) {
+    return ret;
+  }
+
+  // Notifications carry the registration token
+  memcpy(this->observeToken, this->token, this->tokenLength);
+  this->observeTokenLength = this->tokenLength;
+  this->observeCallback = callback;
+  strcpy(this->observePath, path);
+
+  ret = this->exchange(&request, &response);
+  if (ret < 0) {
+    this->observeCallback = nullptr;
+    return ret;
+  }
+
+  // 2. The server only keeps us registered if it echoes the Observe option
+  this->observing = (coap_get_option_int(&response, COAP_OPTION_OBSERVE) >= 0);
+  if (!this->observing) {
+    LOG_WRN("Server doesn't support observing %s\r\n", path);
+  }
+
+  payload = coap_packet_get_payload(&response, &length);
+  callback(coap_header_get_code(&response), payload, length);
+
+  if (!this->observing) {
+    this->observeCallback = nullptr;
+  }
+
+  return 0;
+}
+
+int CoapClient::cancelObserve() {
+  int ret = 0;
+  struct coap_packet request;
+  struct coap_packet response;
+
+  if (!this->observing) {
+    return 0;
+  }
+
+  // GET with Observe=1 and the registration token deregisters (RFC 7641 section 3.6)
+  ret = this->initRequest(&request, COAP_TYPE_CON, COAP_METHOD_GET, this->observeToken, this->observeTokenLength);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = coap_append_option_int(&request, COAP_OPTION_OBSERVE, 1);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = this->appendPath(&request, this->observePath);
+  if (ret < 0) {
+    return ret;
+  }
+
+  this->observing = false;
+  this->observeCallback = nullptr;
+
+  return this->exchange(&request, &response);
+}
+
+int CoapClient::process(int32_t timeoutMs) {
+  int ret = 0;
+  int count = 0;
+  struct coap_packet packet;
+
+  // Handle everything that arrives within the timeout, mostly observe notifications
+  ret = this->receive(&packet, timeoutMs);
+  while (ret == 0) {
+    if (this->dispatchNotification(&packet)) {
+      count++;
+    }
+    ret = this->receive(&packet, 0);
+  }
+
+  return (ret == -EAGAIN) ? count : ret;
+}
+
+uint32_t CoapClient::bytesSent() const {
+  return this->sentBytes;
+}
+
+uint32_t CoapClient::bytesReceived() const {
+  return this->receivedBytes;
+}
+
+int64_t CoapClient::lastRoundTripMs() const {
+  return this->roundTripMs;
+}
+
+int CoapClient::open() {
+  int ret = 0;
+
+  if (this->sock >= 0) {
+    return 0;
+  }
+
+  // A connected UDP socket only receives from the server
+  this->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (this->sock < 0) {
+    LOG_ERR("Failed to create CoAP socket (%d)\r\n", -errno);
+    return -errno;
+  }
+
+  ret = connect(this->sock, &this->socketAddress, sizeof(this->socketAddress));
+  if (ret < 0) {
+    ret = -errno;
+    LOG_ERR("Cannot connect to remote (%d)\r\n", ret);
+    close(this->sock);
+    this->sock = -1;
+    return ret;
+  }
+
+  return 0;
+}
+
+int CoapClient::initRequest(struct coap_packet *request,
+                            uint8_t type,
+                            uint8_t method,
+                            uint8_t *token,
+                            uint8_t tokenLength) {
+  int ret = 0;
+
+  ret = this->open();
+  if (ret < 0) {
+    return ret;
+  }
+
+  // Reuse the given token, or draw a fresh one
+  if (token != nullptr) {
+    memcpy(this->token, token, tokenLength);
+    this->tokenLength = tokenLength;
+  } else {
+    sys_rand_get(this->token, sizeof(this->token));
+    this->tokenLength = sizeof(this->token);
+  }
+
+  ret = coap_packet_init(request,
+                         this->txBuffer,
+                         sizeof(this->txBuffer),
+                         COAP_VERSION_1,
+                         type,
+                         this->tokenLength,
+                         this->token,
+                         method,
+                         coap_next_id());
+  if (ret < 0) {
+    LOG_ERR("Failed to initialize CoAP request (%d)\r\n", ret);
+  }
+
+  return ret;
+}
+
+int CoapClient::appendPath(struct coap_packet *request, const char *path) {
+  int ret = 0;
+  const char *segment = path;
+  const char *end = nullptr;
+
+  // One Uri-Path option per segment, "a/b" -> "a", "b"
+  while ((segment != nullptr) && (*segment != '\0')) {
+    end = strchr(segment, '/');
+    if (end != segment) {
+      ret = coap_packet_append_option(request,
+                                      COAP_OPTION_URI_PATH,
+                                      (const uint8_t *)segment,
+                                      (end != nullptr) ? (end - segment) : strlen(segment));
+      if (ret < 0) {
+        LOG_ERR("Failed to append path to CoAP request (%d)\r\n", ret);
+        return ret;
+      }
+    }
+    segment = (end != nullptr) ? (end + 1) : nullptr;
+  }
+
+  return 0;
+}
+
+int CoapClient::sendBlock(const char *path,
+                          uint32_t number,
+                          bool more,
+                          const uint8_t *data,
+                          uint16_t length,
+                          std::function<void(uint8_t, const uint8_t *, uint16_t)> callback) {
+  int ret = 0;
+  uint8_t code = 0;
+  uint16_t payloadLength = 0;
+  const uint8_t *payload = nullptr;
+  struct coap_packet request;
+  struct coap_packet response;
+
+  // 1. Confirmable POST, options must be appended in increasing option number order
+  ret = this->initRequest(&request, COAP_TYPE_CON, COAP_METHOD_POST, nullptr, 0);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = this->appendPath(&request, path);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = coap_append_option_int(&request, COAP_OPTION_CONTENT_FORMAT, COAP_CONTENT_FORMAT_APP_JSON);
+  if (ret < 0) {
+    return ret;
+  }
+
+  // 2. Block1 option, only needed when the body doesn't fit in one block
+  if (more || (number > 0)) {
+    ret = coap_append_option_int(&request,
+                                 COAP_OPTION_BLOCK1,
+                                 (number << 4) | (more ? 0x08 : 0x00) | COAP_CLIENT_BLOCK_SIZE);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+
+  if (length > 0) {
+    ret = coap_packet_append_payload_marker(&request);
+    if (ret < 0) {
+      return ret;
+    }
+    ret = coap_packet_append_payload(&request, data, length);
+    if (ret < 0) {
+      LOG_ERR("CoAP payload doesn't fit (%d)\r\n", ret);
+      return ret;
+    }
+  }
+
+  // 3. Send it and wait for the acknowledgement
+  ret = this->exchange(&request, &response);
+  if (ret < 0) {
+    return ret;
+  }
+
+  code = coap_header_get_code(&response);
+  payload = coap_packet_get_payload(&response, &payloadLength);
+
+  // Intermediate blocks must be answered with 2.31 Continue
+  if (more) {
+    if (code != COAP_RESPONSE_CODE_CONTINUE) {
+      LOG_ERR("Server rejected block %d (code %d.%02d)\r\n", number, code >> 5, code & 0x1F);
+      if (callback) {
+        callback(code, payload, payloadLength);
+      }
+      return -EPROTO;
+    }
+    return 0;
+  }
+
+  if (callback) {
+    callback(code, payload, payloadLength);
+  }
+
+  return code;
+}
+
+int CoapClient::exchange(struct coap_packet *request, struct coap_packet *response) {
+  int ret = 0;
+  bool acknowledged = false;
+  uint8_t type = 0;
+  uint8_t token[COAP_TOKEN_MAX_LEN];
+  uint8_t tokenLength = 0;
+  uint16_t id = coap_header_get_id(request);
+  int32_t timeoutMs = COAP_CLIENT_ACK_TIMEOUT_MS;
+  int64_t start = k_uptime_get();
+  int64_t deadline = 0;
+  int64_t now = 0;
+
+  for (uint32_t attempt = 0; attempt <= COAP_CLIENT_MAX_RETRANSMIT; attempt++) {
+
+    // 1. (Re)transmit the confirmable message, unless it's already acknowledged
+    if (!acknowledged) {
+      ret = send(this->sock, request->data, request->offset, 0);
+      if (ret < 0) {
+        LOG_ERR("Failed to send CoAP request (%d)\r\n", -errno);
+        return -errno;
+      }
+      this->sentBytes += ret;
+    }
+
+    // 2. Wait for the ACK, exponential back-off between retransmissions
+    deadline = k_uptime_get() + timeoutMs;
+    while ((now = k_uptime_get()) < deadline) {
+      ret = this->receive(response, deadline - now);
+      if (ret == -EAGAIN) {
+        break;
+      }
+      if (ret < 0) {
+        return ret;
+      }
+
+      type = coap_header_get_type(response);
+      tokenLength = coap_header_get_token(response, token);
+
+      if ((type == COAP_TYPE_RESET) && (coap_header_get_id(response) == id)) {
+        LOG_ERR("Server reset the CoAP request\r\n");
+        return -ECONNRESET;
+      }
+
+      if ((type == COAP_TYPE_ACK) && (coap_header_get_id(response) == id)) {
+        if (coap_header_get_code(response) == COAP_CODE_EMPTY) {
+          // Empty ACK: the response comes later in its own message, stop retransmitting
+          acknowledged = true;
+          continue;
+        }
+        // Piggybacked response
+        this->roundTripMs = k_uptime_get() - start;
+        return 0;
+      }
+
+      if (((type == COAP_TYPE_CON) || (type == COAP_TYPE_NON_CON)) &&
+          (tokenLength == this->tokenLength) &&
+          (memcmp(token, this->token, tokenLength) == 0)) {
+        // Separate response, acknowledge it if the server asks for it
+        if (type == COAP_TYPE_CON) {
+          this->sendEmpty(COAP_TYPE_ACK, coap_header_get_id(response));
+        }
+        this->roundTripMs = k_uptime_get() - start;
+        return 0;
+      }
+
+      // Not ours, maybe a notification for an observed resource
+      this->dispatchNotification(response);
+    }
+
+    timeoutMs *= 2;
+  }
+
+  LOG_ERR("CoAP request timed out\r\n");
+
+  return -ETIMEDOUT;
+}
+
+int CoapClient::receive(struct coap_packet *packet, int32_t timeoutMs) {
+  int ret = 0;
+  struct pollfd fds = {.fd = this->sock, .events = POLLIN, .revents = 0};
+
+  if (this->sock < 0) {
+    return -ENOTCONN;
+  }
+
+  ret = poll(&fds, 1, timeoutMs);
+  if (ret < 0) {
+    return -errno;
+  }
+  if (ret == 0) {
+    return -EAGAIN;
+  }
+
+  ret = recv(this->sock, this->rxBuffer, sizeof(this->rxBuffer), 0);
+  if (ret < 0) {
+    LOG_ERR("Failed to receive CoAP packet (%d)\r\n", -errno);
+    return -errno;
+  }
+  this->receivedBytes += ret;
+
+  ret = coap_packet_parse(packet, this->rxBuffer, ret, NULL, 0);
+  if (ret < 0) {
+    LOG_WRN("Dropping malformed CoAP packet (%d)\r\n", ret);
+    return -EAGAIN;
+  }
+
+  return 0;
+}
+
+bool CoapClient::dispatchNotification(struct coap_packet *packet) {
+  uint8_t type = coap_header_get_type(packet);
+  uint8_t token[COAP_TOKEN_MAX_LEN];
+  uint8_t tokenLength = coap_header_get_token(packet, token);
+  uint16_t length = 0;
+  const uint8_t *payload = nullptr;
+
+  if (!this->observing ||
+      (tokenLength != this->observeTokenLength) ||
+      (memcmp(token, this->observeToken, tokenLength) != 0)) {
+    // Unknown confirmable message: reset it so the server forgets about us
+    if (type == COAP_TYPE_CON) {
+      this->sendEmpty(COAP_TYPE_RESET, coap_header_get_id(packet));
+    }
+    return false;
+  }
+
+  if (type == COAP_TYPE_CON) {
+    this->sendEmpty(COAP_TYPE_ACK, coap_header_get_id(packet));
+  }
+
+  payload = coap_packet_get_payload(packet, &length);
+  if (this->observeCallback) {
+    this->observeCallback(coap_header_get_code(packet), payload, length);
+  }
+
+  return true;
+}
+
+int CoapClient::sendEmpty(uint8_t type, uint16_t id) {
+  int ret = 0;
+  struct coap_packet packet;
+  uint8_t buffer[4];
+
+  ret = coap_packet_init(&packet, buffer, sizeof(buffer), COAP_VERSION_1, type, 0, NULL, COAP_CODE_EMPTY, id);
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = send(this->sock, packet.data, packet.offset, 0);
+  if (ret < 0) {
+    return -errno;
+  }
+  this->sentBytes += ret;
+
+  return 0;
+}
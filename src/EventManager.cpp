@@ -1,17 +1,319 @@
+// Lib C includes
+#include <errno.h>
+#include <stdlib.h>
+
+// Lib C++ includes
+#include <atomic>
+
 // Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
 #include <zephyr/zbus/zbus.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/shell/shell.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(EventManager);
 
 // User C++ class headers
 #include "EventManager.h"
+#include "ActiveObject.h"
+
+// Function declaration of channel validators
+static bool connectivityChannelValidator(const void *message, size_t size);
+static bool controlChannelValidator(const void *message, size_t size);
+static bool acquisitionChannelValidator(const void *message, size_t size);
+static bool uploadChannelValidator(const void *message, size_t size);
+
+// ZBUS channels definition, one per topic
+ZBUS_CHAN_DEFINE(
+  connectivityChannel,                     // Channel name
+  event_t,                                 // Message type
+  connectivityChannelValidator,            // Validator function
+  NULL,                                    // User data
+  ZBUS_OBSERVERS(ZBUS_OBSERVERS_EMPTY),    // Initial observers list
+  ZBUS_MSG_INIT(.id = EVENT_INITIAL_VALUE) // Message initialization
+);
 
-// ZBUS channel definition
 ZBUS_CHAN_DEFINE(
-  eventsChannel,                           // Channel name
+  controlChannel,                          // Channel name
   event_t,                                 // Message type
-  NULL,                                    // Validator function
+  controlChannelValidator,                 // Validator function
   NULL,                                    // User data
   ZBUS_OBSERVERS(ZBUS_OBSERVERS_EMPTY),    // Initial observers list
   ZBUS_MSG_INIT(.id = EVENT_INITIAL_VALUE) // Message initialization
-);
\ No newline at end of file
+);
+
+ZBUS_CHAN_DEFINE(
+  acquisitionChannel,                      // Channel name
+  event_t,                                 // Message type
+  acquisitionChannelValidator,             // Validator function
+  NULL,                                    // User data
+  ZBUS_OBSERVERS(ZBUS_OBSERVERS_EMPTY),    // Initial observers list
+  ZBUS_MSG_INIT(.id = EVENT_INITIAL_VALUE) // Message initialization
+);
+
+ZBUS_CHAN_DEFINE(
+  uploadChannel,                           // Channel name
+  event_t,                                 // Message type
+  uploadChannelValidator,                  // Validator function
+  NULL,                                    // User data
+  ZBUS_OBSERVERS(ZBUS_OBSERVERS_EMPTY),    // Initial observers list
+  ZBUS_MSG_INIT(.id = EVENT_INITIAL_VALUE) // Message initialization
+);
+
+// Counters per event id, updated from any publisher
+static std::atomic<uint32_t> publishedCounts[EVENT_MAX_VALUE];
+static std::atomic<uint32_t> failedCounts[EVENT_MAX_VALUE];
+
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+// Receiving end of "events stress", checks every event arrives once and in order.
+// On its own work queue, so the uploader never waits behind a flood of test events.
+static ActiveObject eventStressSink("eventStressSink", ACTIVE_OBJECT_PRIORITY_TEST);
+static std::atomic<uint32_t> stressReceived(0);
+static std::atomic<uint32_t> stressOutOfOrder(0);
+static std::atomic<uint32_t> stressNext(0);
+#endif
+
+// Periodic metrics summary
+static void eventMetricsReportWorkHandler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(eventMetricsReportWork, eventMetricsReportWorkHandler);
+
+static bool validateEvent(const void *message, size_t size, event_channel_t channel) {
+  const event_t *event = (const event_t *)message;
+
+  if ((size != sizeof(event_t)) || (event->id <= EVENT_INITIAL_VALUE) || (event->id >= EVENT_MAX_VALUE)) {
+    return false;
+  }
+
+  // Only sensor data events carry a block, anything else with one is a publisher bug
+  return (EVENT_CHANNELS[event->id] == channel) &&
+         ((event->block == nullptr) || (event->id == EVENT_SENSOR_DATA_SAVED));
+}
+
+static bool connectivityChannelValidator(const void *message, size_t size) {
+  return validateEvent(message, size, EVENT_CHANNEL_CONNECTIVITY);
+}
+
+static bool controlChannelValidator(const void *message, size_t size) {
+  return validateEvent(message, size, EVENT_CHANNEL_CONTROL);
+}
+
+static bool acquisitionChannelValidator(const void *message, size_t size) {
+  return validateEvent(message, size, EVENT_CHANNEL_ACQUISITION);
+}
+
+static bool uploadChannelValidator(const void *message, size_t size) {
+  return validateEvent(message, size, EVENT_CHANNEL_UPLOAD);
+}
+
+const struct zbus_channel *eventChannel(event_id_t id) {
+  if (id >= EVENT_MAX_VALUE) {
+    return nullptr;
+  }
+
+  switch (EVENT_CHANNELS[id]) {
+    case EVENT_CHANNEL_CONNECTIVITY:
+      return &connectivityChannel;
+    case EVENT_CHANNEL_CONTROL:
+      return &controlChannel;
+    case EVENT_CHANNEL_ACQUISITION:
+      return &acquisitionChannel;
+    case EVENT_CHANNEL_UPLOAD:
+      return &uploadChannel;
+    default:
+      return nullptr;
+  }
+}
+
+int eventPublish(const event_t &event, k_timeout_t timeout) {
+  int ret = 0;
+  const struct zbus_channel *channel = eventChannel(event.id);
+
+  if (channel == nullptr) {
+    return -EINVAL;
+  }
+
+  // Listeners of the channel first, they see the event while its payload is guaranteed alive.
+  // A malformed event is refused by the channel validator with -ENOMSG and reaches nobody.
+  ret = zbus_chan_pub(channel, &event, timeout);
+
+  // Then a copy per active object, waiting for room rather than dropping it
+  if (ret == 0) {
+    ret = ActiveObject::dispatch(event, timeout);
+  }
+
+  if (ret < 0) {
+    failedCounts[event.id].fetch_add(1, std::memory_order_relaxed);
+    LOG_WRN("Failed to publish <%s>: %d\r\n", EVENT_ID_TO_STRING(event.id), ret);
+    return ret;
+  }
+  publishedCounts[event.id].fetch_add(1, std::memory_order_relaxed);
+
+  return 0;
+}
+
+event_counters_t eventCounters(event_id_t id) {
+  event_counters_t counters = {0};
+
+  if (id < EVENT_MAX_VALUE) {
+    counters.published = publishedCounts[id].load(std::memory_order_relaxed);
+    counters.failed = failedCounts[id].load(std::memory_order_relaxed);
+  }
+
+  return counters;
+}
+
+void eventHistogramAdd(event_histogram_t *histogram, uint32_t durationUs) {
+  uint32_t bucket = 0;
+  uint32_t limitUs = EVENT_HISTOGRAM_FIRST_BUCKET_US;
+
+  while ((bucket < (EVENT_HISTOGRAM_BUCKETS - 1)) && (durationUs >= limitUs)) {
+    bucket++;
+    limitUs *= 4;
+  }
+
+  histogram->buckets[bucket]++;
+  histogram->maxUs = MAX(histogram->maxUs, durationUs);
+}
+
+static void printHistogram(const struct shell *shell, const char *label, const event_histogram_t &histogram) {
+  shell_print(shell, "  %-9s <16us:%u <64us:%u <256us:%u <1ms:%u <4ms:%u <16ms:%u <64ms:%u >=64ms:%u max:%uus",
+              label,
+              histogram.buckets[0], histogram.buckets[1], histogram.buckets[2], histogram.buckets[3],
+              histogram.buckets[4], histogram.buckets[5], histogram.buckets[6], histogram.buckets[7],
+              histogram.maxUs);
+}
+
+static int eventsStatsCommand(const struct shell *shell, size_t argc, char **argv) {
+  shell_print(shell, "%-40s %-20s %10s %8s", "Event", "Channel", "Published", "Failed");
+  for (uint32_t id = EVENT_INITIAL_VALUE + 1; id < EVENT_MAX_VALUE; id++) {
+    event_counters_t counters = eventCounters((event_id_t)id);
+    shell_print(shell, "%-40s %-20s %10u %8u", EVENT_ID_TO_STRING(id), zbus_chan_name(eventChannel((event_id_t)id)),
+                counters.published, counters.failed);
+  }
+
+  for (uint32_t index = 0; index < ActiveObject::count(); index++) {
+    ActiveObject *object = ActiveObject::at(index);
+    active_object_metrics_t metrics = object->metrics();
+
+    shell_print(shell, "%s: %u handled, %u dropped, queue high-water %u/%u",
+                object->name(), metrics.handled, metrics.dropped, metrics.queueHighWater, ACTIVE_OBJECT_QUEUE_SIZE);
+    printHistogram(shell, "latency", metrics.latency);
+    printHistogram(shell, "run time", metrics.runTime);
+  }
+
+  return 0;
+}
+
+static int eventsResetCommand(const struct shell *shell, size_t argc, char **argv) {
+  for (uint32_t id = 0; id < EVENT_MAX_VALUE; id++) {
+    publishedCounts[id].store(0, std::memory_order_relaxed);
+    failedCounts[id].store(0, std::memory_order_relaxed);
+  }
+  for (uint32_t index = 0; index < ActiveObject::count(); index++) {
+    ActiveObject::at(index)->resetMetrics();
+  }
+  shell_print(shell, "Event metrics cleared");
+
+  return 0;
+}
+
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+static int eventsStressCommand(const struct shell *shell, size_t argc, char **argv) {
+  uint32_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : EVENT_STRESS_DEFAULT_COUNT;
+  uint32_t failed = 0;
+  uint32_t received = 0;
+  uint32_t accepted = 0;
+  int64_t start = 0;
+  int64_t elapsedMs = 0;
+  event_t event = {.id = EVENT_BUS_STRESS};
+
+  if (count == 0) {
+    shell_error(shell, "Usage: events stress [count]");
+    return -EINVAL;
+  }
+
+  stressReceived.store(0, std::memory_order_relaxed);
+  stressOutOfOrder.store(0, std::memory_order_relaxed);
+  stressNext.store(0, std::memory_order_relaxed);
+
+  // As fast as the shell thread can go, the sink only keeps up because publishers wait for room
+  start = k_uptime_get();
+  for (uint32_t sequence = 0; sequence < count; sequence++) {
+    event.batch = sequence;
+    if (eventPublish(event, K_MSEC(EVENT_PUBLISH_TIMEOUT_MS)) < 0) {
+      failed++;
+    }
+  }
+
+  // Let the sink drain its queue, it can't take longer than one timeout per queued event
+  for (uint32_t attempt = 0; attempt < ACTIVE_OBJECT_QUEUE_SIZE; attempt++) {
+    received = stressReceived.load(std::memory_order_relaxed);
+    if ((received + failed) >= count) {
+      break;
+    }
+    k_msleep(EVENT_PUBLISH_TIMEOUT_MS);
+  }
+  elapsedMs = k_uptime_get() - start;
+  accepted = count - failed;
+
+  shell_print(shell, "%u events in %lld ms (%lld/s): %u failed to publish, %u received, %u lost, %u out of order",
+              count, elapsedMs, (elapsedMs > 0) ? ((int64_t)count * 1000) / elapsedMs : 0LL, failed, received,
+              (accepted > received) ? (accepted - received) : 0, stressOutOfOrder.load(std::memory_order_relaxed));
+
+  // Every event accepted by eventPublish() must come out exactly once, the publisher knows about the others
+  if ((received != accepted) || (stressOutOfOrder.load(std::memory_order_relaxed) != 0)) {
+    shell_error(shell, "Event bus stress test FAILED");
+    return -EIO;
+  }
+  shell_print(shell, "Event bus stress test passed");
+
+  return 0;
+}
+#endif
+
+SHELL_STATIC_SUBCMD_SET_CREATE(eventsCommands,
+  SHELL_CMD(stats, NULL, "Show publications per event and queue depth and latency per active object", eventsStatsCommand),
+  SHELL_CMD(reset, NULL, "Clear the event metrics", eventsResetCommand),
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+  SHELL_CMD_ARG(stress, NULL, "Publish events back to back and check none is lost: [count]", eventsStressCommand, 1, 1),
+#endif
+  SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(events, &eventsCommands, "Event bus commands", NULL);
+
+static void eventMetricsReportWorkHandler(struct k_work *work) {
+  // One line per active object, enough to follow trends from the log
+  for (uint32_t index = 0; index < ActiveObject::count(); index++) {
+    ActiveObject *object = ActiveObject::at(index);
+    active_object_metrics_t metrics = object->metrics();
+
+    LOG_INF("<%s> handled %d, dropped %d, high-water %d, max latency %d us, max run time %d us\r\n",
+            object->name(), metrics.handled, metrics.dropped, metrics.queueHighWater,
+            metrics.latency.maxUs, metrics.runTime.maxUs);
+  }
+
+  k_work_schedule(&eventMetricsReportWork, K_MSEC(EVENT_METRICS_REPORT_PERIOD_MS));
+}
+
+static int eventMetricsInit() {
+#ifdef CONFIG_APP_EVENT_BUS_STRESS
+  // Events are numbered from 0 by "events stress", gaps are publications that failed, going back is a bug
+  eventStressSink.on(EVENT_BUS_STRESS, [](const event_t &event) {
+    if (event.batch < stressNext.load(std::memory_order_relaxed)) {
+      stressOutOfOrder.fetch_add(1, std::memory_order_relaxed);
+    }
+    stressNext.store(event.batch + 1, std::memory_order_relaxed);
+    stressReceived.fetch_add(1, std::memory_order_relaxed);
+  });
+#endif
+
+  if (EVENT_METRICS_REPORT_PERIOD_MS > 0) {
+    k_work_schedule(&eventMetricsReportWork, K_MSEC(EVENT_METRICS_REPORT_PERIOD_MS));
+  }
+
+  return 0;
+}
+
+SYS_INIT(eventMetricsInit, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
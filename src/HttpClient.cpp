@@ -7,110 +7,173 @@ LOG_MODULE_REGISTER(HttpClient);
 
 // User C++ class headers
 #include "HttpClient.h"
+#include "HttpConnectionPool.h"
+#include "HttpRequestQueue.h"
 
 static void httpResponseCallback(struct http_response *response,
                                  enum http_final_call finalData,
                                  void *userData);
+static int sendAll(int sock, const uint8_t *data, size_t length);
 
-HttpClient::HttpClient(char *server, uint16_t port) {
+// Header announcing a body of unknown length streamed as chunks
+static const char *CHUNKED_HEADERS[] = {"Transfer-Encoding: chunked\r\n", NULL};
+
+HttpClient::HttpClient(char *server, uint16_t port, bool keepAlive) {
   // 1. Initialize attributes
-  this->sock = 0;
+  this->sock = -1;
   this->server = server;
   this->port = port;
+  this->keepAlive = keepAlive;
+  this->bodyStarted = false;
+
+  // 2. Build the server address once, it doesn't change between requests
+  memset((void *)&this->socketAddress, 0, sizeof(this->socketAddress));
+  net_sin(&this->socketAddress)->sin_family = AF_INET;
+  net_sin(&this->socketAddress)->sin_port = htons(port);
+  inet_pton(AF_INET, server, &net_sin(&this->socketAddress)->sin_addr);
 }
 
 HttpClient::~HttpClient() {
   // Destructor is automatically called when the object goes out of scope or is explicitly deleted
 }
 
-int HttpClient::get(const char *endpoint, std::function<void(uint8_t *, uint32_t)> callback) {
-  int ret = 0;
-  struct http_request request = {0};
+int HttpClient::get(const char *endpoint, std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback) {
+  return this->request(HTTP_GET, endpoint, nullptr, 0, nullptr, callback);
+}
 
-  // 0. Create socket
-  memset((void *)&this->socketAddress, 0, sizeof(this->socketAddress));
-  net_sin(&this->socketAddress)->sin_family = AF_INET;
-  net_sin(&this->socketAddress)->sin_port = htons(port);
-  inet_pton(AF_INET, server, &net_sin(&this->socketAddress)->sin_addr);
-  this->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+int HttpClient::post(const char *endpoint,
+                     const char *data,
+                     uint32_t length,
+                     std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback) {
+  return this->request(HTTP_POST, endpoint, data, length, nullptr, callback);
+}
 
-  if (this->sock < 0) {
-    LOG_ERR("Failed to create HTTP socket (%d)\r\n", -errno);
+int HttpClient::postStream(const char *endpoint,
+                           std::function<int(uint8_t *, uint32_t)> producer,
+                           std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback) {
+  if (producer == nullptr) {
+    LOG_ERR("Failed to register producer\r\n");
+    return -EINVAL;
   }
 
-  if (callback == nullptr) {
-    LOG_ERR("Failed to register callback\r\n");
-    ret = -errno;
-    return ret;
+  return this->request(HTTP_POST, endpoint, nullptr, 0, producer, callback);
+}
+
+int HttpClient::getAsync(const char *endpoint,
+                         std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback,
+                         event_id_t completionEvent) {
+  return HttpRequestQueue::getInstance().enqueue(&this->socketAddress, this->server, HTTP_GET, endpoint,
+                                                 nullptr, 0, nullptr, callback, completionEvent,
+                                                 this->keepAlive);
+}
+
+int HttpClient::postAsync(const char *endpoint,
+                          const char *data,
+                          uint32_t length,
+                          std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback,
+                          event_id_t completionEvent) {
+  return HttpRequestQueue::getInstance().enqueue(&this->socketAddress, this->server, HTTP_POST, endpoint,
+                                                 data, length, nullptr, callback, completionEvent,
+                                                 this->keepAlive);
+}
+
+int HttpClient::postStreamAsync(const char *endpoint,
+                                std::function<int(uint8_t *, uint32_t)> producer,
+                                std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback,
+                                event_id_t completionEvent) {
+  if (producer == nullptr) {
+    LOG_ERR("Failed to register producer\r\n");
+    return -EINVAL;
   }
 
-  this->callback = callback;
+  return HttpRequestQueue::getInstance().enqueue(&this->socketAddress, this->server, HTTP_POST, endpoint,
+                                                 nullptr, 0, producer, callback, completionEvent,
+                                                 this->keepAlive);
+}
 
-  // 1. Open TCP connection
-  ret = connect(this->sock, &this->socketAddress, sizeof(this->socketAddress));
-  if (ret < 0) {
-    LOG_ERR("Cannot connect to remote (%d)", -errno);
-    ret = -errno;
-    return ret;
+int HttpClient::sendChunks(int sock) {
+  int ret = 0;
+  int length = 0;
+  int total = 0;
+  bool last = false;
+  uint8_t *start = nullptr;
+  uint8_t chunk[HTTP_CLIENT_CHUNK_FRAME_SIZE];
+
+  while (!last) {
+    // 1. Pull the next piece of the body from the producer and frame it
+    length = frameChunk(chunk, this->producer, &start, &last);
+    if (length < 0) {
+      return length;
+    }
+
+    // 2. Send the whole frame, blocking only as long as the socket needs to take it
+    ret = sendAll(sock, start, length);
+    if (ret < 0) {
+      return ret;
+    }
+    total += ret;
   }
 
-  // 2. Send GET request
-  request.method = HTTP_GET;
-  request.url = endpoint;
-  request.host = this->server;
-  request.protocol = "HTTP/1.1";
-  request.response = httpResponseCallback;
-  request.recv_buf = this->httpResponseBuffer;
-  request.recv_buf_len = sizeof(this->httpResponseBuffer);
-  ret = http_client_req(this->sock, &request, 5000, (void *)&this->callback);
-  if (ret < 0) {
-    LOG_ERR("Error sending GET request\r\n");
-    ret = -errno;
-    return ret;
+  return total;
+}
+
+int HttpClient::frameChunk(uint8_t *frame,
+                           const std::function<int(uint8_t *, uint32_t)> &producer,
+                           uint8_t **start,
+                           bool *last) {
+  int length = 0;
+  int header = 0;
+
+  // 1. Let the producer write right after the space reserved for the size prefix
+  length = producer(&frame[HTTP_CLIENT_CHUNK_PREFIX_SIZE], HTTP_CLIENT_CHUNK_SIZE);
+  if (length < 0) {
+    LOG_ERR("Body producer failed (%d)\r\n", length);
+    return length;
+  }
+  if ((uint32_t)length > HTTP_CLIENT_CHUNK_SIZE) {
+    length = HTTP_CLIENT_CHUNK_SIZE;
   }
 
-  // 3. Close TCP connection
-  close(this->sock);
+  // 2. An empty piece ends the body with the last chunk
+  if (length == 0) {
+    memcpy(frame, "0\r\n\r\n", sizeof("0\r\n\r\n") - 1);
+    *start = frame;
+    *last = true;
+    return sizeof("0\r\n\r\n") - 1;
+  }
 
-  return ret;
+  // 3. Right-align the hex size so the prefix ends where the data starts
+  header = snprintf((char *)frame, HTTP_CLIENT_CHUNK_PREFIX_SIZE + 1, "%x\r\n", length);
+  memmove(&frame[HTTP_CLIENT_CHUNK_PREFIX_SIZE - header], frame, header);
+  memcpy(&frame[HTTP_CLIENT_CHUNK_PREFIX_SIZE + length], "\r\n", 2);
+
+  *start = &frame[HTTP_CLIENT_CHUNK_PREFIX_SIZE - header];
+  *last = false;
+
+  return header + length + 2;
 }
 
-int HttpClient::post(const char *endpoint,
-                     const char *data,
-                     uint32_t length,
-                     std::function<void(uint8_t *, uint32_t)> callback) {
+int HttpClient::request(enum http_method method,
+                        const char *endpoint,
+                        const char *data,
+                        uint32_t length,
+                        std::function<int(uint8_t *, uint32_t)> producer,
+                        std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback) {
   int ret = 0;
+  bool reused = false;
   struct http_request request = {0};
-
-  // 0. Create socket
-  memset((void *)&this->socketAddress, 0, sizeof(this->socketAddress));
-  net_sin(&this->socketAddress)->sin_family = AF_INET;
-  net_sin(&this->socketAddress)->sin_port = htons(port);
-  inet_pton(AF_INET, server, &net_sin(&this->socketAddress)->sin_addr);
-  this->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-
-  if (this->sock < 0) {
-    LOG_ERR("Failed to create HTTP socket (%d)\r\n", -errno);
-  }
+  HttpConnectionPool& pool = HttpConnectionPool::getInstance();
 
   if (callback == nullptr) {
     LOG_ERR("Failed to register callback\r\n");
-    ret = -errno;
-    return ret;
+    return -EINVAL;
   }
 
-  this->callback = callback;
+  this->producer = producer;
+  this->bodyStarted = false;
 
-  // 1. Open TCP connection
-  ret = connect(this->sock, &this->socketAddress, sizeof(this->socketAddress));
-  if (ret < 0) {
-    LOG_ERR("Cannot connect to remote (%d)", -errno);
-    ret = -errno;
-    return ret;
-  }
-
-  // 2. Send POST request
-  request.method = HTTP_POST;
+  // 0. Prepare the request
+  request.method = method;
   request.host = this->server;
   request.url = endpoint;
   request.protocol = "HTTP/1.1";
@@ -119,15 +182,89 @@ int HttpClient::post(const char *endpoint,
   request.payload_len = length;
   request.recv_buf = this->httpResponseBuffer;
   request.recv_buf_len = sizeof(this->httpResponseBuffer);
-  ret = http_client_req(this->sock, &request, 5000, (void *)this);
-  if (ret < 0) {
-    LOG_ERR("Error sending POST request\r\n");
-    ret = -errno;
+  if (producer != nullptr) {
+    request.optional_headers = CHUNKED_HEADERS;
+  }
+  if (method != HTTP_GET) {
+    // The body always goes through the callback, so we know whether the server may have got any of it
+    request.payload_cb = HttpClient::payloadCallback;
+  }
+
+  if (!this->keepAlive) {
+    // 1. Open TCP connection
+    this->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (this->sock < 0) {
+      LOG_ERR("Failed to create HTTP socket (%d)\r\n", -errno);
+      return -errno;
+    }
+
+    ret = connect(this->sock, &this->socketAddress, sizeof(this->socketAddress));
+    if (ret < 0) {
+      ret = -errno;
+      LOG_ERR("Cannot connect to remote (%d)", ret);
+      close(this->sock);
+      return ret;
+    }
+
+    // 2. Send request
+    this->response.begin(callback);
+    ret = this->execute(this->sock, &request);
+    if (ret < 0) {
+      this->response.fail(ret);
+    }
+
+    // 3. Close TCP connection
+    close(this->sock);
+    this->sock = -1;
+
     return ret;
   }
 
-  // 3. Close TCP connection
-  close(this->sock);
+  // 1. Take a connection from the pool, reusing a kept-alive one when possible
+  this->sock = pool.acquire(&this->socketAddress, &reused);
+  if (this->sock < 0) {
+    return this->sock;
+  }
+
+  // 2. Send request
+  this->response.begin(callback);
+  ret = this->execute(this->sock, &request);
+
+  // The server may have dropped a reused connection right before we wrote to it,
+  // in that case reconnect once and replay the request transparently. Only as long
+  // as no body byte was sent: the server can't act on a request without its body,
+  // while one that got the whole body may have, and a producer can't be rewound.
+  // A GET has no body and is safe to repeat.
+  if ((ret < 0) && reused && !this->bodyStarted) {
+    LOG_DBG("Kept-alive connection is stale, reconnecting\r\n");
+    pool.release(this->sock, false);
+    this->sock = pool.acquire(&this->socketAddress, &reused);
+    if (this->sock < 0) {
+      return this->sock;
+    }
+    memset(&request.internal, 0, sizeof(request.internal));
+    this->response.begin(callback);
+    ret = this->execute(this->sock, &request);
+  }
+
+  if (ret < 0) {
+    this->response.fail(ret);
+  }
+
+  // 3. Give the connection back, unless it failed or the server asked to close it
+  pool.release(this->sock, (ret >= 0) && this->response.keepAlive());
+  this->sock = -1;
+
+  return ret;
+}
+
+int HttpClient::execute(int sock, struct http_request *request) {
+  int ret = 0;
+
+  ret = http_client_req(sock, request, 5000, (void *)this);
+  if (ret < 0) {
+    LOG_ERR("Error sending %s request (%d)\r\n", http_method_str(request->method), ret);
+  }
 
   return ret;
 }
@@ -149,9 +286,46 @@ static void httpResponseCallback(struct http_response *response,
   } else if (finalData == HTTP_DATA_FINAL) {
     LOG_DBG("All the data received (%zd bytes)", response->data_len);
   }
-  LOG_DBG("Response status %s", response->http_status);
 
-  if (httpClientInstance->callback) {
-    httpClientInstance->callback(response->recv_buf, response->data_len);
+  // Each call carries the raw bytes received since the previous one, parse them incrementally
+  httpClientInstance->response.feed(response->recv_buf, response->data_len);
+
+  if (finalData == HTTP_DATA_FINAL) {
+    httpClientInstance->response.finish();
   }
 }
+
+int HttpClient::payloadCallback(int sock, struct http_request *request, void *userData) {
+  HttpClient *httpClientInstance = nullptr;
+
+  if (userData == nullptr) {
+    LOG_ERR("Invalid callback parameters\r\n");
+    return -EINVAL;
+  }
+
+  httpClientInstance = static_cast<HttpClient *>(userData);
+
+  // Headers are out, from here on the request must not be replayed
+  httpClientInstance->bodyStarted = true;
+  if (httpClientInstance->producer != nullptr) {
+    return httpClientInstance->sendChunks(sock);
+  }
+
+  return sendAll(sock, (const uint8_t *)request->payload, request->payload_len);
+}
+
+static int sendAll(int sock, const uint8_t *data, size_t length) {
+  ssize_t ret = 0;
+  size_t sent = 0;
+
+  while (sent < length) {
+    ret = send(sock, &data[sent], length - sent, 0);
+    if (ret < 0) {
+      LOG_ERR("Failed to send body (%d)\r\n", -errno);
+      return -errno;
+    }
+    sent += ret;
+  }
+
+  return sent;
+}
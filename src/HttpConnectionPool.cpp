@@ -0,0 +1,248 @@
+// Lib C includes
+#include <string.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_ip.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(HttpConnectionPool);
+
+// User C++ class headers
+#include "HttpConnectionPool.h"
+
+static bool isSameServer(const struct sockaddr *a, const struct sockaddr *b);
+
+// Define the static member
+HttpConnectionPool HttpConnectionPool::instance;
+
+HttpConnectionPool& HttpConnectionPool::getInstance() {
+  // Return the singleton instance
+  return instance;
+}
+
+HttpConnectionPool::HttpConnectionPool() {
+  k_mutex_init(&this->mutex);
+
+  for (auto &connection : this->connections) {
+    connection.sock = -1;
+    connection.inUse = false;
+    connection.lastUsed = 0;
+    memset(&connection.address, 0, sizeof(connection.address));
+  }
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+}
+
+int HttpConnectionPool::acquire(const struct sockaddr *address, bool *reused) {
+  struct connection *slot = nullptr;
+  int sock = -1;
+
+  if ((address == nullptr) || (reused == nullptr)) {
+    LOG_ERR("Invalid arguments\r\n");
+    return -EINVAL;
+  }
+
+  *reused = false;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  this->expireIdleConnections();
+
+  // 1. Try to reuse an idle socket that is already connected to the same server
+  sock = this->takeIdle(address);
+  if (sock >= 0) {
+    k_mutex_unlock(&this->mutex);
+    *reused = true;
+    return sock;
+  }
+
+  // 2. Reserve a slot so the connect below can run without holding the lock
+  slot = this->reserveSlot(address);
+
+  k_mutex_unlock(&this->mutex);
+
+  // 3. Open a new TCP connection
+  sock = connectTo(address);
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  if (slot != nullptr) {
+    if (sock < 0) {
+      slot->inUse = false;
+    } else {
+      slot->sock = sock;
+    }
+  }
+  k_mutex_unlock(&this->mutex);
+
+  // When every slot is busy the socket is simply not pooled and gets closed on release
+  return sock;
+}
+
+int HttpConnectionPool::acquireIdle(const struct sockaddr *address) {
+  int sock = -1;
+
+  if (address == nullptr) {
+    LOG_ERR("Invalid arguments\r\n");
+    return -EINVAL;
+  }
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  this->expireIdleConnections();
+  sock = this->takeIdle(address);
+  k_mutex_unlock(&this->mutex);
+
+  return (sock >= 0) ? sock : -ENOENT;
+}
+
+void HttpConnectionPool::adopt(int sock, const struct sockaddr *address) {
+  struct connection *slot = nullptr;
+
+  if ((sock < 0) || (address == nullptr)) {
+    return;
+  }
+
+  // The socket may still be connecting, it is in use until released so nobody else gets it meanwhile
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  slot = this->reserveSlot(address);
+  if (slot != nullptr) {
+    slot->sock = sock;
+  }
+  k_mutex_unlock(&this->mutex);
+}
+
+void HttpConnectionPool::release(int sock, bool reusable) {
+  if (sock < 0) {
+    return;
+  }
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  for (auto &connection : this->connections) {
+    if (connection.sock == sock) {
+      if (reusable) {
+        connection.lastUsed = k_uptime_get();
+      } else {
+        close(connection.sock);
+        connection.sock = -1;
+      }
+      connection.inUse = false;
+      k_mutex_unlock(&this->mutex);
+      return;
+    }
+  }
+
+  k_mutex_unlock(&this->mutex);
+
+  // Not a pooled socket
+  close(sock);
+}
+
+int HttpConnectionPool::connectTo(const struct sockaddr *address) {
+  int ret = 0;
+  int sock = -1;
+
+  sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock < 0) {
+    LOG_ERR("Failed to create HTTP socket (%d)\r\n", -errno);
+    return -errno;
+  }
+
+  ret = connect(sock, address, sizeof(*address));
+  if (ret < 0) {
+    ret = -errno;
+    LOG_ERR("Cannot connect to remote (%d)\r\n", ret);
+    close(sock);
+    return ret;
+  }
+
+  return sock;
+}
+
+bool HttpConnectionPool::isAlive(int sock) {
+  uint8_t byte = 0;
+  ssize_t ret = 0;
+
+  // Peek without blocking: EAGAIN means the connection is open and idle,
+  // 0 means the server sent FIN, any data means a stale response we can't use
+  ret = recv(sock, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+  if (ret < 0) {
+    return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+  }
+
+  return false;
+}
+
+void HttpConnectionPool::expireIdleConnections() {
+  int64_t now = k_uptime_get();
+
+  for (auto &connection : this->connections) {
+    if ((connection.sock >= 0) &&
+        !connection.inUse &&
+        ((now - connection.lastUsed) > HTTP_CONNECTION_IDLE_TIMEOUT_MS)) {
+      LOG_DBG("Closing idle socket %d\r\n", connection.sock);
+      close(connection.sock);
+      connection.sock = -1;
+    }
+  }
+}
+
+int HttpConnectionPool::takeIdle(const struct sockaddr *address) {
+  for (auto &connection : this->connections) {
+    if ((connection.sock < 0) || connection.inUse || !isSameServer(&connection.address, address)) {
+      continue;
+    }
+
+    if (isAlive(connection.sock)) {
+      connection.inUse = true;
+      LOG_DBG("Reusing kept-alive socket %d\r\n", connection.sock);
+      return connection.sock;
+    }
+
+    // The server closed this connection while it was idle
+    LOG_DBG("Socket %d was closed by the server\r\n", connection.sock);
+    close(connection.sock);
+    connection.sock = -1;
+  }
+
+  return -1;
+}
+
+struct HttpConnectionPool::connection *HttpConnectionPool::reserveSlot(const struct sockaddr *address) {
+  struct connection *slot = nullptr;
+  struct connection *oldest = nullptr;
+
+  // Find a free slot, or evict the least recently used idle socket
+  for (auto &connection : this->connections) {
+    if (connection.inUse) {
+      continue;
+    }
+    if (connection.sock < 0) {
+      slot = &connection;
+      break;
+    }
+    if ((oldest == nullptr) || (connection.lastUsed < oldest->lastUsed)) {
+      oldest = &connection;
+    }
+  }
+
+  if ((slot == nullptr) && (oldest != nullptr)) {
+    close(oldest->sock);
+    oldest->sock = -1;
+    slot = oldest;
+  }
+
+  if (slot != nullptr) {
+    slot->inUse = true;
+    memcpy(&slot->address, address, sizeof(slot->address));
+  }
+
+  return slot;
+}
+
+static bool isSameServer(const struct sockaddr *a, const struct sockaddr *b) {
+  return (a->sa_family == b->sa_family) &&
+         (net_sin(a)->sin_port == net_sin(b)->sin_port) &&
+         (net_sin(a)->sin_addr.s_addr == net_sin(b)->sin_addr.s_addr);
+}
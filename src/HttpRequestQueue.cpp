@@ -0,0 +1,454 @@
+// Lib C includes
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_ip.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/zbus/zbus.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(HttpRequestQueue);
+
+// User C++ class headers
+#include "ActiveObject.h"
+#include "EventManager.h"
+#include "HttpClient.h"
+#include "HttpConnectionPool.h"
+#include "HttpResponse.h"
+#include "HttpRequestQueue.h"
+
+static_assert(HTTP_REQUEST_QUEUE_PAYLOAD_SIZE >= HTTP_CLIENT_CHUNK_FRAME_SIZE,
+              "The payload buffer must be able to stage one chunk frame");
+
+// Define the static member
+HttpRequestQueue HttpRequestQueue::instance;
+
+HttpRequestQueue& HttpRequestQueue::getInstance() {
+  // Return the singleton instance
+  return instance;
+}
+
+HttpRequestQueue::HttpRequestQueue() {
+  k_mutex_init(&this->mutex);
+  k_work_init_delayable(&this->pollWork, HttpRequestQueue::pollWorkHandler);
+  this->order = 0;
+
+  for (auto &request : this->requests) {
+    request.state = STATE_FREE;
+    request.sock = -1;
+  }
+}
+
+HttpRequestQueue::~HttpRequestQueue() {
+}
+
+int HttpRequestQueue::enqueue(const struct sockaddr *address,
+                              const char *host,
+                              enum http_method method,
+                              const char *endpoint,
+                              const char *data,
+                              uint32_t length,
+                              std::function<int(uint8_t *, uint32_t)> producer,
+                              std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback,
+                              event_id_t completionEvent,
+                              bool keepAlive) {
+  struct request *slot = nullptr;
+  int ret = 0;
+
+  if ((address == nullptr) || (host == nullptr) || (endpoint == nullptr)) {
+    LOG_ERR("Invalid arguments\r\n");
+    return -EINVAL;
+  }
+
+  if (length > sizeof(slot->payload)) {
+    LOG_ERR("Payload too large for an asynchronous request (%d bytes)\r\n", length);
+    return -EMSGSIZE;
+  }
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  for (auto &request : this->requests) {
+    if (request.state == STATE_FREE) {
+      slot = &request;
+      break;
+    }
+  }
+
+  if (slot == nullptr) {
+    k_mutex_unlock(&this->mutex);
+    LOG_WRN("HTTP request queue is full\r\n");
+    return -EBUSY;
+  }
+
+  // Everything the request needs is copied now, the caller's buffers can go away
+  ret = snprintf(slot->header, sizeof(slot->header),
+                 "%s %s HTTP/1.1\r\nHost: %s\r\n",
+                 http_method_str(method), endpoint, host);
+  if (producer != nullptr) {
+    ret += snprintf(slot->header + ret, sizeof(slot->header) - ret, "Transfer-Encoding: chunked\r\n\r\n");
+  } else if ((data != nullptr) && (length > 0)) {
+    ret += snprintf(slot->header + ret, sizeof(slot->header) - ret, "Content-Length: %u\r\n\r\n", length);
+  } else {
+    ret += snprintf(slot->header + ret, sizeof(slot->header) - ret, "\r\n");
+  }
+
+  if (ret >= (int)sizeof(slot->header)) {
+    k_mutex_unlock(&this->mutex);
+    LOG_ERR("Request headers don't fit in %d bytes\r\n", sizeof(slot->header));
+    return -EMSGSIZE;
+  }
+
+  slot->headerLength = ret;
+  slot->payloadLength = ((data != nullptr) && (producer == nullptr)) ? length : 0;
+  if (slot->payloadLength > 0) {
+    memcpy(slot->payload, data, slot->payloadLength);
+  }
+  memcpy(&slot->address, address, sizeof(slot->address));
+  slot->producer = producer;
+  slot->callback = callback;
+  slot->completionEvent = completionEvent;
+  slot->keepAlive = keepAlive;
+  slot->retried = false;
+  slot->order = this->order++;
+  slot->state = STATE_QUEUED;
+
+  k_mutex_unlock(&this->mutex);
+
+  // Start it right away rather than at the next poll of the requests in flight
+  k_work_reschedule_for_queue(ActiveObject::queueOf(ACTIVE_OBJECT_PRIORITY_NORMAL), &this->pollWork, K_NO_WAIT);
+
+  return 0;
+}
+
+void HttpRequestQueue::pollWorkHandler(struct k_work *work) {
+  HttpRequestQueue::getInstance().advance();
+}
+
+void HttpRequestQueue::advance() {
+  int ret = 0;
+  int count = 0;
+  int64_t now = 0;
+  struct pollfd fds[HTTP_REQUEST_QUEUE_MAX_IN_FLIGHT];
+  struct request *polled[HTTP_REQUEST_QUEUE_MAX_IN_FLIGHT];
+  struct request *next = nullptr;
+  uint32_t inFlight = 0;
+
+  // 1. Start queued requests, oldest first, as long as there is room for more sockets
+  while (true) {
+    next = nullptr;
+    inFlight = 0;
+
+    k_mutex_lock(&this->mutex, K_FOREVER);
+    for (auto &request : this->requests) {
+      if ((request.state != STATE_FREE) && (request.state != STATE_QUEUED)) {
+        inFlight++;
+      } else if ((request.state == STATE_QUEUED) &&
+                 ((next == nullptr) || ((int32_t)(request.order - next->order) < 0))) {
+        next = &request;
+      }
+    }
+    k_mutex_unlock(&this->mutex);
+
+    if ((next == nullptr) || (inFlight >= HTTP_REQUEST_QUEUE_MAX_IN_FLIGHT)) {
+      break;
+    }
+    this->start(next);
+  }
+
+  // 2. Collect the sockets in flight and what each one is waiting for
+  now = k_uptime_get();
+  for (auto &request : this->requests) {
+    if ((request.state == STATE_FREE) || (request.state == STATE_QUEUED)) {
+      continue;
+    }
+    if (now >= request.deadline) {
+      LOG_ERR("Request timed out\r\n");
+      this->finish(&request, -ETIMEDOUT);
+      continue;
+    }
+    fds[count].fd = request.sock;
+    fds[count].events = (request.state == STATE_RECEIVING) ? POLLIN : POLLOUT;
+    fds[count].revents = 0;
+    polled[count] = &request;
+    count++;
+  }
+
+  // Nothing in flight: the next enqueue() submits the work again
+  if (count == 0) {
+    return;
+  }
+
+  // 3. Check the sockets without waiting, the work queue is shared with the active objects
+  ret = poll(fds, count, 0);
+  if (ret < 0) {
+    LOG_ERR("poll() failed (%d)\r\n", -errno);
+  }
+
+  // 4. Advance every socket that is ready
+  for (int index = 0; (ret > 0) && (index < count); index++) {
+    if (fds[index].revents == 0) {
+      continue;
+    }
+    if (polled[index]->state == STATE_RECEIVING) {
+      this->onReadable(polled[index]);
+    } else {
+      this->onWritable(polled[index]);
+    }
+  }
+
+  // 5. Come back right after the work queue handled whatever else is pending if anything moved, a bit later otherwise
+  k_work_reschedule_for_queue(ActiveObject::queueOf(ACTIVE_OBJECT_PRIORITY_NORMAL), &this->pollWork,
+                              (ret > 0) ? K_NO_WAIT : K_MSEC(HTTP_REQUEST_QUEUE_POLL_INTERVAL_MS));
+}
+
+void HttpRequestQueue::start(struct request *request) {
+  int ret = 0;
+  HttpConnectionPool& pool = HttpConnectionPool::getInstance();
+
+  request->sock = -1;
+  request->deadline = k_uptime_get() + HTTP_REQUEST_QUEUE_TIMEOUT_MS;
+  request->reused = false;
+  request->replayable = true;
+  request->txStage = TX_HEADER;
+  request->tx = nullptr;
+  request->txLength = 0;
+  request->txSent = 0;
+  request->response.begin(request->callback);
+
+  // 1. Reuse a kept-alive connection to the same server, the pool probes it before handing it out
+  if (request->keepAlive) {
+    request->sock = pool.acquireIdle(&request->address);
+    if (request->sock >= 0) {
+      request->reused = true;
+      ret = fcntl(request->sock, F_SETFL, O_NONBLOCK);
+      if (ret < 0) {
+        LOG_ERR("Failed to make HTTP socket non-blocking (%d)\r\n", -errno);
+        this->finish(request, -errno);
+        return;
+      }
+      request->state = STATE_SENDING;
+      return;
+    }
+  }
+
+  // 2. Otherwise create a non-blocking socket, pooled on release when the request is keep-alive
+  request->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (request->sock < 0) {
+    LOG_ERR("Failed to create HTTP socket (%d)\r\n", -errno);
+    this->finish(request, -errno);
+    return;
+  }
+
+  if (request->keepAlive) {
+    pool.adopt(request->sock, &request->address);
+  }
+
+  ret = fcntl(request->sock, F_SETFL, O_NONBLOCK);
+  if (ret < 0) {
+    LOG_ERR("Failed to make HTTP socket non-blocking (%d)\r\n", -errno);
+    this->finish(request, -errno);
+    return;
+  }
+
+  // 3. Start connecting, poll() reports the socket writable once the handshake is done
+  ret = connect(request->sock, &request->address, sizeof(request->address));
+  if ((ret < 0) && (errno != EINPROGRESS)) {
+    LOG_ERR("Cannot connect to remote (%d)\r\n", -errno);
+    this->finish(request, -errno);
+    return;
+  }
+
+  request->state = (ret == 0) ? STATE_SENDING : STATE_CONNECTING;
+}
+
+bool HttpRequestQueue::retryStale(struct request *request, int result) {
+  // The server may have dropped a reused connection right before we wrote to it, in that case reconnect
+  // once and replay the request, but only if not a single byte of it went out: past that point the server
+  // may act on it, and a replay could upload the same data twice. A timeout isn't a stale socket, it's a
+  // slow server.
+  if ((result >= 0) || (result == -ETIMEDOUT) || !request->reused || request->retried || !request->replayable) {
+    return false;
+  }
+
+  LOG_DBG("Kept-alive connection is stale, reconnecting\r\n");
+  HttpConnectionPool::getInstance().release(request->sock, false);
+  request->sock = -1;
+  request->retried = true;
+  this->start(request);
+
+  return true;
+}
+
+void HttpRequestQueue::onWritable(struct request *request) {
+  int error = 0;
+  socklen_t length = sizeof(error);
+  ssize_t ret = 0;
+
+  // 1. Check the outcome of the non-blocking connect
+  if (request->state == STATE_CONNECTING) {
+    ret = getsockopt(request->sock, SOL_SOCKET, SO_ERROR, &error, &length);
+    if ((ret < 0) || (error != 0)) {
+      LOG_ERR("Cannot connect to remote (%d)\r\n", (ret < 0) ? -errno : -error);
+      this->finish(request, (ret < 0) ? -errno : -error);
+      return;
+    }
+    request->state = STATE_SENDING;
+  }
+
+  // 2. Push as much of the request as the socket takes without blocking
+  while (true) {
+    if (request->txSent == request->txLength) {
+      ret = this->nextTxBuffer(request);
+      if (ret < 0) {
+        this->finish(request, ret);
+        return;
+      }
+      if (ret == 0) {
+        // The whole request is out, now wait for the response
+        request->state = STATE_RECEIVING;
+        return;
+      }
+    }
+
+    ret = send(request->sock, &request->tx[request->txSent], request->txLength - request->txSent, 0);
+    if (ret < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        return;
+      }
+      LOG_ERR("Failed to send request (%d)\r\n", -errno);
+      this->finish(request, -errno);
+      return;
+    }
+    request->txSent += ret;
+    request->response.addSent(ret);
+    if (ret > 0) {
+      request->replayable = false;
+    }
+  }
+}
+
+void HttpRequestQueue::onReadable(struct request *request) {
+  ssize_t ret = 0;
+
+  while (true) {
+    ret = recv(request->sock, request->rxBuffer, sizeof(request->rxBuffer), 0);
+    if (ret < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        return;
+      }
+      LOG_ERR("Failed to receive response (%d)\r\n", -errno);
+      this->finish(request, -errno);
+      return;
+    }
+
+    // Closed before anything came back: a kept-alive socket the server dropped, or a reset
+    if ((ret == 0) && (request->response.bytesReceived() == 0)) {
+      LOG_ERR("Connection closed before the response\r\n");
+      this->finish(request, -ECONNRESET);
+      return;
+    }
+
+    // Connection closed: that ends a response without Content-Length
+    if (ret == 0) {
+      request->response.finish();
+      this->finish(request, request->response.error());
+      return;
+    }
+
+    // Body slices are handed to the callback straight from the receive buffer
+    ret = request->response.feed(request->rxBuffer, ret);
+    if (ret < 0) {
+      this->finish(request, ret);
+      return;
+    }
+
+    if (request->response.isComplete()) {
+      this->finish(request, 0);
+      return;
+    }
+  }
+}
+
+int HttpRequestQueue::nextTxBuffer(struct request *request) {
+  bool last = false;
+  int length = 0;
+  uint8_t *start = nullptr;
+
+  switch (request->txStage) {
+
+    case TX_HEADER: {
+      request->tx = (uint8_t *)request->header;
+      request->txLength = request->headerLength;
+      request->txStage = ((request->payloadLength > 0) || request->producer) ? TX_BODY : TX_DONE;
+      break;
+    }
+
+    case TX_BODY: {
+      if (!request->producer) {
+        request->tx = request->payload;
+        request->txLength = request->payloadLength;
+        request->txStage = TX_DONE;
+        break;
+      }
+
+      // Pull one chunk from the producer, framed in place in the payload buffer
+      length = HttpClient::frameChunk(request->payload, request->producer, &start, &last);
+      if (length < 0) {
+        return length;
+      }
+      request->tx = start;
+      request->txLength = length;
+      request->txStage = last ? TX_DONE : TX_BODY;
+      break;
+    }
+
+    case TX_DONE:
+    default: {
+      return 0;
+    }
+  }
+
+  request->txSent = 0;
+
+  return 1;
+}
+
+void HttpRequestQueue::finish(struct request *request, int result) {
+  event_t event = {.id = request->completionEvent};
+
+  if (this->retryStale(request, result)) {
+    return;
+  }
+
+  if ((request->sock >= 0) && request->keepAlive) {
+    // Handed back blocking, HttpClient::request() uses pooled sockets synchronously.
+    // Only a response that ended on its own framing leaves the connection reusable.
+    fcntl(request->sock, F_SETFL, fcntl(request->sock, F_GETFL, 0) & ~O_NONBLOCK);
+    HttpConnectionPool::getInstance().release(request->sock, (result == 0) && request->response.keepAlive());
+    request->sock = -1;
+  } else if (request->sock >= 0) {
+    close(request->sock);
+    request->sock = -1;
+  }
+
+  LOG_DBG("Request finished (%d)\r\n", result);
+
+  // A failed request still gets its final (empty) callback, with the error set
+  if (result < 0) {
+    request->response.fail(result);
+  }
+
+  // Waiting for room is pointless, the objects to be notified run on this same work queue
+  if (request->completionEvent != EVENT_INITIAL_VALUE) {
+    eventPublish(event, K_NO_WAIT);
+  }
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  request->response.begin(nullptr);
+  request->producer = nullptr;
+  request->callback = nullptr;
+  request->state = STATE_FREE;
+  k_mutex_unlock(&this->mutex);
+}
@@ -0,0 +1,260 @@
+// Lib C includes
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+
+// Zephyr includes
+#include <zephyr/net/http/parser.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(HttpResponse);
+
+// User C++ class headers
+#include "HttpResponse.h"
+
+// Parser callbacks, shared by every response
+const struct http_parser_settings HttpResponse::settings = [] {
+  struct http_parser_settings settings;
+
+  http_parser_settings_init(&settings);
+  settings.on_header_field = HttpResponse::onHeaderField;
+  settings.on_header_value = HttpResponse::onHeaderValue;
+  settings.on_headers_complete = HttpResponse::onHeadersComplete;
+  settings.on_body = HttpResponse::onBody;
+  settings.on_message_complete = HttpResponse::onMessageComplete;
+
+  return settings;
+}();
+
+HttpResponse::HttpResponse() {
+  this->begin(nullptr);
+}
+
+HttpResponse::~HttpResponse() {
+  // Destructor is automatically called when the object goes out of scope or is explicitly deleted
+}
+
+void HttpResponse::begin(std::function<void(const HttpResponse &, const uint8_t *, uint32_t)> callback) {
+  this->callback = callback;
+
+  http_parser_init(&this->parser, HTTP_RESPONSE);
+  this->parser.data = this;
+  this->headersComplete = false;
+  this->complete = false;
+  this->ended = false;
+  this->lastError = 0;
+  this->sentBytes = 0;
+  this->receivedBytes = 0;
+
+  this->headerState = HEADER_NONE;
+  this->headersLength = 0;
+  this->headerCount = 0;
+}
+
+int HttpResponse::feed(const uint8_t *data, uint32_t length) {
+  size_t parsed = 0;
+
+  if (this->ended) {
+    return 0;
+  }
+
+  this->receivedBytes += length;
+  parsed = http_parser_execute(&this->parser, &settings, (const char *)data, length);
+  if (HTTP_PARSER_ERRNO(&this->parser) != HPE_OK) {
+    LOG_ERR("Malformed HTTP response: %s\r\n", http_errno_name(HTTP_PARSER_ERRNO(&this->parser)));
+    this->fail(-EBADMSG);
+    return -EBADMSG;
+  }
+
+  return parsed;
+}
+
+void HttpResponse::finish() {
+  if (this->ended) {
+    return;
+  }
+
+  // Tell the parser the connection is closed, that ends a body without Content-Length
+  http_parser_execute(&this->parser, &settings, NULL, 0);
+
+  if (!this->complete) {
+    this->fail(-ECONNRESET);
+  }
+}
+
+void HttpResponse::fail(int error) {
+  if (this->ended) {
+    return;
+  }
+
+  this->lastError = error;
+  this->end();
+}
+
+void HttpResponse::addSent(uint32_t length) {
+  this->sentBytes += length;
+}
+
+uint32_t HttpResponse::bytesSent() const {
+  return this->sentBytes;
+}
+
+uint32_t HttpResponse::bytesReceived() const {
+  return this->receivedBytes;
+}
+
+uint16_t HttpResponse::status() const {
+  return this->headersComplete ? this->parser.status_code : 0;
+}
+
+int64_t HttpResponse::contentLength() const {
+  // The parser keeps ULLONG_MAX when the header is absent
+  if (!this->headersComplete || (this->parser.content_length == ULLONG_MAX) || this->isChunked()) {
+    return -1;
+  }
+
+  return this->parser.content_length;
+}
+
+bool HttpResponse::isChunked() const {
+  return (this->parser.flags & F_CHUNKED) != 0;
+}
+
+bool HttpResponse::isComplete() const {
+  return this->complete;
+}
+
+bool HttpResponse::keepAlive() const {
+  return this->complete && http_should_keep_alive(&this->parser);
+}
+
+int HttpResponse::error() const {
+  return this->lastError;
+}
+
+const char *HttpResponse::header(const char *name) const {
+  if (!this->headersComplete || (name == nullptr)) {
+    return nullptr;
+  }
+
+  for (uint32_t index = 0; index < this->headerCount; index++) {
+    if (strcasecmp(&this->headers[this->headerNames[index]], name) == 0) {
+      return &this->headers[this->headerValues[index]];
+    }
+  }
+
+  return nullptr;
+}
+
+void HttpResponse::end() {
+  this->ended = true;
+
+  // The empty slice tells the callback the response is over, check isComplete() or error()
+  if (this->callback) {
+    this->callback(*this, nullptr, 0);
+  }
+}
+
+bool HttpResponse::append(const char *data, size_t length) {
+  if ((this->headersLength + length) >= sizeof(this->headers)) {
+    return false;
+  }
+
+  memcpy(&this->headers[this->headersLength], data, length);
+  this->headersLength += length;
+
+  return true;
+}
+
+int HttpResponse::onHeaderField(struct http_parser *parser, const char *at, size_t length) {
+  HttpResponse *response = static_cast<HttpResponse *>(parser->data);
+
+  // Once the table is full the remaining headers are only parsed, not kept
+  if (response->headerState == HEADER_SKIP) {
+    return 0;
+  }
+
+  // A field after a value (or the very first field) starts a new header
+  if ((response->headerState == HEADER_NONE) || (response->headerState == HEADER_VALUE)) {
+    if (response->headerState == HEADER_VALUE) {
+      if (response->append("", 1)) {
+        response->headerCount++;
+      } else {
+        response->headersLength = response->headerNames[response->headerCount];
+      }
+    }
+    if (response->headerCount >= HTTP_RESPONSE_MAX_HEADERS) {
+      response->headerState = HEADER_SKIP;
+      return 0;
+    }
+    response->headerNames[response->headerCount] = response->headersLength;
+    response->headerState = HEADER_FIELD;
+  }
+
+  if ((response->headerState == HEADER_FIELD) && !response->append(at, length)) {
+    LOG_WRN("HTTP response header table is full\r\n");
+    response->headersLength = response->headerNames[response->headerCount];
+    response->headerState = HEADER_SKIP;
+  }
+
+  return 0;
+}
+
+int HttpResponse::onHeaderValue(struct http_parser *parser, const char *at, size_t length) {
+  HttpResponse *response = static_cast<HttpResponse *>(parser->data);
+
+  if (response->headerState == HEADER_FIELD) {
+    if (!response->append("", 1)) {
+      response->headersLength = response->headerNames[response->headerCount];
+      response->headerState = HEADER_SKIP;
+      return 0;
+    }
+    response->headerValues[response->headerCount] = response->headersLength;
+    response->headerState = HEADER_VALUE;
+  }
+
+  if ((response->headerState == HEADER_VALUE) && !response->append(at, length)) {
+    LOG_WRN("HTTP response header table is full\r\n");
+    response->headersLength = response->headerNames[response->headerCount];
+    response->headerState = HEADER_SKIP;
+  }
+
+  return 0;
+}
+
+int HttpResponse::onHeadersComplete(struct http_parser *parser) {
+  HttpResponse *response = static_cast<HttpResponse *>(parser->data);
+
+  // Close the last header
+  if (response->headerState == HEADER_VALUE) {
+    if (response->append("", 1)) {
+      response->headerCount++;
+    } else {
+      response->headersLength = response->headerNames[response->headerCount];
+    }
+  }
+  response->headerState = HEADER_NONE;
+  response->headersComplete = true;
+
+  return 0;
+}
+
+int HttpResponse::onBody(struct http_parser *parser, const char *at, size_t length) {
+  HttpResponse *response = static_cast<HttpResponse *>(parser->data);
+
+  // Chunk framing is already stripped, this slice points into the caller's buffer
+  if (response->callback && (length > 0)) {
+    response->callback(*response, (const uint8_t *)at, length);
+  }
+
+  return 0;
+}
+
+int HttpResponse::onMessageComplete(struct http_parser *parser) {
+  HttpResponse *response = static_cast<HttpResponse *>(parser->data);
+
+  // Anything fed after this message is ignored
+  response->complete = true;
+  response->end();
+
+  return 0;
+}
@@ -1,13 +1,48 @@
+// Lib C includes
+#include <errno.h>
+#include <string.h>
+
 // Zephyr includes
+#include <zephyr/kernel.h>
 #include <zephyr/net/net_core.h>
 #include <zephyr/net/net_context.h>
+#include <zephyr/net/net_event.h>
+#include <zephyr/net/dhcpv4.h>
+#include <zephyr/net/ethernet.h>
+#include <zephyr/net/socket.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(Network);
 
 // User C++ class headers
 #include "Network.h"
+#include "EventManager.h"
+#include "Storage.h"
+
+// State events
+static constexpr uint32_t NETWORK_EVENT_READY = BIT(0);
+
+// Events that may change the state
+static constexpr uint32_t NETWORK_IFACE_EVENTS = NET_EVENT_IF_UP | NET_EVENT_IF_DOWN;
+static constexpr uint32_t NETWORK_IPV4_EVENTS = NET_EVENT_IPV4_ADDR_ADD | NET_EVENT_IPV4_ADDR_DEL |
+                                               NET_EVENT_IPV4_DHCP_BOUND;
+
+// ARP over Ethernet and IPv4, as in RFC 826
+static constexpr uint16_t NETWORK_ARP_HWTYPE_ETHERNET = 1;
+static constexpr uint16_t NETWORK_ARP_OP_REQUEST = 1;
 
-static void netMgmtCallback(struct net_mgmt_event_callback *cb, uint32_t event, struct net_if *iface);
+// ARP packet with its Ethernet header, as sent and received on the probe socket
+typedef struct {
+  struct net_eth_hdr eth;
+  uint16_t hwtype;
+  uint16_t protocol;
+  uint8_t hwlen;
+  uint8_t protolen;
+  uint16_t opcode;
+  struct net_eth_addr srcHwaddr;
+  struct in_addr srcIpaddr;
+  struct net_eth_addr dstHwaddr;
+  struct in_addr dstIpaddr;
+} __packed network_arp_frame_t;
 
 // Define the static member
 Network Network::instance;
@@ -18,8 +53,23 @@ Network& Network::getInstance() {
 }
 
 Network::Network() {
-  net_mgmt_init_event_callback(&this->_mgmtEventCb, netMgmtCallback, NET_EVENT_IPV4_ADDR_ADD);
-  net_mgmt_add_event_callback(&this->_mgmtEventCb);
+  this->_state = NETWORK_STATE_IDLE;
+  this->_started = false;
+  this->_provisional = false;
+  this->_leaseBoundMs = 0;
+  this->_probeSocket = -1;
+  this->_probesSent = 0;
+  memset(&this->_lease, 0, sizeof(this->_lease));
+  k_mutex_init(&this->_stateLock);
+  k_event_init(&this->_stateEvents);
+  k_work_init_delayable(&this->_provisionalWork, Network::provisionalWorkHandler);
+  k_work_init_delayable(&this->_leaseSaveWork, Network::leaseSaveWorkHandler);
+  k_work_init_delayable(&this->_probeWork, Network::probeWorkHandler);
+
+  net_mgmt_init_event_callback(&this->_ifaceEventCb, Network::netMgmtCallback, NETWORK_IFACE_EVENTS);
+  net_mgmt_add_event_callback(&this->_ifaceEventCb);
+  net_mgmt_init_event_callback(&this->_ipv4EventCb, Network::netMgmtCallback, NETWORK_IPV4_EVENTS);
+  net_mgmt_add_event_callback(&this->_ipv4EventCb);
   this->_netIface = net_if_get_default();
 }
 
@@ -27,7 +77,18 @@ Network::~Network() {
 }
 
 void Network::start() {
+  k_mutex_lock(&this->_stateLock, K_FOREVER);
+  this->_started = true;
+  k_mutex_unlock(&this->_stateLock);
+
+  // Uploads can start with the last address while DHCP runs, once no one else answers for it
+  if (NETWORK_LEASE_CACHE_ENABLED) {
+    this->restoreLease();
+  }
+
+  // The DHCP client follows the link by itself, restarting after a link loss or a lost lease
   net_dhcpv4_start(this->_netIface);
+  this->update();
 }
 
 void Network::onGotIP(std::function<void(const char *)> callback) {
@@ -39,22 +100,323 @@ void Network::onGotIP(std::function<void(const char *)> callback) {
   this->callback = callback;
 }
 
-static void netMgmtCallback(struct net_mgmt_event_callback *cb, uint32_t event, struct net_if *iface) {
+network_state_t Network::state() const {
+  return this->_state;
+}
+
+bool Network::isReady() const {
+  return this->_state == NETWORK_STATE_READY;
+}
+
+int Network::waitUntilReady(k_timeout_t timeout) {
+  if (k_event_wait(&this->_stateEvents, NETWORK_EVENT_READY, false, timeout) == 0) {
+    return -EAGAIN;
+  }
+
+  return 0;
+}
+
+void Network::update() {
+  char ipBuffer[NET_IPV4_ADDR_LEN] = {0};
+  struct in_addr *address = nullptr;
+  network_state_t previous = NETWORK_STATE_IDLE;
+  network_state_t next = NETWORK_STATE_IDLE;
+  event_t event = {.id = EVENT_INITIAL_VALUE};
+
+  k_mutex_lock(&this->_stateLock, K_FOREVER);
+
+  // Any preferred address will do, DHCP or static, whichever slot it's in
+  address = net_if_ipv4_get_global_addr(this->_netIface, NET_ADDR_PREFERRED);
+  if (!this->_started) {
+    next = NETWORK_STATE_IDLE;
+  } else if (!net_if_is_up(this->_netIface)) {
+    next = NETWORK_STATE_LINK_DOWN;
+  } else if (address == nullptr) {
+    next = NETWORK_STATE_CONNECTING;
+  } else {
+    next = NETWORK_STATE_READY;
+  }
+
+  previous = this->_state;
+  this->_state = next;
+  if (next == NETWORK_STATE_READY) {
+    k_event_post(&this->_stateEvents, NETWORK_EVENT_READY);
+  } else {
+    k_event_clear(&this->_stateEvents, NETWORK_EVENT_READY);
+  }
+
+  // The address may go away once the lock is released, take a copy of it for the callback
+  if ((next == NETWORK_STATE_READY) && (next != previous) &&
+      (net_addr_ntop(AF_INET, address, ipBuffer, sizeof(ipBuffer)) == nullptr)) {
+    LOG_ERR("Error while converting IP address to string form\r\n");
+  }
+
+  k_mutex_unlock(&this->_stateLock);
+
+  // Announced without the lock, a full active object queue must not stall the net_mgmt thread with it.
+  // A transition already overtaken by a newer one is left to whoever made the newer one.
+  if ((next == previous) || (this->_state != next)) {
+    return;
+  }
+  LOG_INF("%s -> %s\r\n", NETWORK_STATE_TO_STRING(previous), NETWORK_STATE_TO_STRING(next));
+
+  if (next == NETWORK_STATE_READY) {
+    // Notify the callback if it's set
+    if ((ipBuffer[0] != '\0') && this->callback) {
+      this->callback(ipBuffer);
+    }
+
+    // Publish the <EVENT_NETWORK_AVAILABLE> event on <connectivityChannel>
+    event.id = EVENT_NETWORK_AVAILABLE;
+    eventPublish(event, K_MSEC(EVENT_PUBLISH_TIMEOUT_MS));
+  } else if (previous == NETWORK_STATE_READY) {
+    // Publish the <EVENT_NETWORK_LOST> event on <connectivityChannel>
+    event.id = EVENT_NETWORK_LOST;
+    eventPublish(event, K_MSEC(EVENT_PUBLISH_TIMEOUT_MS));
+  }
+}
+
+void Network::restoreLease() {
+  struct sockaddr_ll linkAddress = {0};
+  int ret = 0;
+
+  // Storage mounts in the background, don't hold the boot for long
+  if (Storage::getInstance().waitUntilReady(K_MSEC(NETWORK_LEASE_STORAGE_TIMEOUT_MS)) < 0) {
+    LOG_WRN("Storage not ready, starting DHCP from scratch\r\n");
+    return;
+  }
+
+  ret = Storage::getInstance().read(NETWORK_LEASE_ID, &this->_lease, sizeof(this->_lease));
+  if ((ret != sizeof(this->_lease)) || (this->_lease.version != NETWORK_LEASE_VERSION)) {
+    memset(&this->_lease, 0, sizeof(this->_lease));
+    return;
+  }
+
+  // Time spent powered off isn't known, the probes below catch an address handed out meanwhile
+  if (this->_lease.usedS >= this->_lease.leaseTimeS) {
+    LOG_INF("Saved lease expired, starting DHCP from scratch\r\n");
+    return;
+  }
+
+  ret = socket(AF_PACKET, SOCK_RAW, htons(NET_ETH_PTYPE_ARP));
+  if (ret < 0) {
+    LOG_WRN("Unable to open the ARP probe socket: %d\r\n", -errno);
+    return;
+  }
+
+  linkAddress.sll_family = AF_PACKET;
+  linkAddress.sll_protocol = htons(NET_ETH_PTYPE_ARP);
+  linkAddress.sll_ifindex = net_if_get_by_iface(this->_netIface);
+  if (bind(ret, (struct sockaddr *)&linkAddress, sizeof(linkAddress)) < 0) {
+    LOG_WRN("Unable to bind the ARP probe socket: %d\r\n", -errno);
+    close(ret);
+    return;
+  }
+
+  // The address is only applied once the probes went unanswered, and dropped if DHCP never confirms it
+  k_mutex_lock(&this->_stateLock, K_FOREVER);
+  this->_probeSocket = ret;
+  this->_probesSent = 0;
+  this->_provisional = true;
+  k_work_schedule(&this->_probeWork, K_NO_WAIT);
+  k_work_schedule(&this->_provisionalWork, K_MSEC(NETWORK_LEASE_CONFIRM_TIMEOUT_MS));
+  k_mutex_unlock(&this->_stateLock);
+}
+
+void Network::leaseBound() {
+  network_lease_t lease;
+  int ret = 0;
+
+  memset(&lease, 0, sizeof(lease));
+  lease.version = NETWORK_LEASE_VERSION;
+  lease.address = this->_netIface->config.dhcpv4.requested_ip;
+  lease.netmask = this->_netIface->config.ip.ipv4->netmask;
+  lease.gateway = this->_netIface->config.ip.ipv4->gw;
+  lease.server = this->_netIface->config.dhcpv4.server_id;
+  lease.leaseTimeS = this->_netIface->config.dhcpv4.lease_time;
+  lease.usedS = 0;
+
+  k_mutex_lock(&this->_stateLock, K_FOREVER);
+
+  // The server may have moved us elsewhere, the saved address must go then
+  if (this->_provisional) {
+    k_work_cancel_delayable(&this->_provisionalWork);
+    this->stopProbe();
+    if (!net_ipv4_addr_cmp(&lease.address, &this->_lease.address)) {
+      LOG_WRN("DHCP handed out another address, dropping the saved one\r\n");
+      net_if_ipv4_addr_rm(this->_netIface, &this->_lease.address);
+    }
+    this->_provisional = false;
+  }
+
+  // Every bind or renewal starts the lease over, which is saved along with the time used so far
+  if (memcmp(&lease, &this->_lease, sizeof(lease)) != 0) {
+    this->_lease = lease;
+    ret = Storage::getInstance().write(NETWORK_LEASE_ID, &this->_lease, sizeof(this->_lease));
+    if (ret < 0) {
+      LOG_ERR("Failed to save the DHCP lease: %d\r\n", ret);
+    }
+  }
+  this->_leaseBoundMs = k_uptime_get();
+  k_work_reschedule(&this->_leaseSaveWork, K_SECONDS(NETWORK_LEASE_SAVE_PERIOD_S));
+
+  k_mutex_unlock(&this->_stateLock);
+}
+
+void Network::provisionalWorkHandler(struct k_work *work) {
+  Network &network = Network::getInstance();
+
+  k_mutex_lock(&network._stateLock, K_FOREVER);
+  if (network._provisional) {
+    // No DHCP server confirmed it, the address may belong to someone else by now
+    LOG_WRN("Saved lease not confirmed, dropping it\r\n");
+    network.stopProbe();
+    net_if_ipv4_addr_rm(network._netIface, &network._lease.address);
+    network._provisional = false;
+  }
+  k_mutex_unlock(&network._stateLock);
+
+  network.update();
+}
+
+void Network::leaseSaveWorkHandler(struct k_work *work) {
+  Network &network = Network::getInstance();
+  int64_t usedS = 0;
+  int ret = 0;
+
+  k_mutex_lock(&network._stateLock, K_FOREVER);
+
+  // A renewal restarts the count, a lease running out stops it as DHCP starts over
+  usedS = (k_uptime_get() - network._leaseBoundMs) / MSEC_PER_SEC;
+  network._lease.usedS = (uint32_t)MIN(usedS, (int64_t)network._lease.leaseTimeS);
+  ret = Storage::getInstance().write(NETWORK_LEASE_ID, &network._lease, sizeof(network._lease));
+  if (ret < 0) {
+    LOG_ERR("Failed to save the DHCP lease: %d\r\n", ret);
+  }
+  if (network._lease.usedS < network._lease.leaseTimeS) {
+    k_work_schedule(&network._leaseSaveWork, K_SECONDS(NETWORK_LEASE_SAVE_PERIOD_S));
+  }
+
+  k_mutex_unlock(&network._stateLock);
+}
+
+void Network::probeWorkHandler(struct k_work *work) {
+  Network &network = Network::getInstance();
   char ipBuffer[NET_IPV4_ADDR_LEN] = {0};
+  bool applied = false;
+
+  k_mutex_lock(&network._stateLock, K_FOREVER);
+
+  // DHCP may have been quicker, or the confirmation timeout may have gone off
+  if (!network._provisional || (network._probeSocket < 0)) {
+    k_mutex_unlock(&network._stateLock);
+    return;
+  }
+
+  net_addr_ntop(AF_INET, &network._lease.address, ipBuffer, sizeof(ipBuffer));
 
-  if (event == NET_EVENT_IPV4_ADDR_ADD) {
-    if (iface->config.ip.ipv4->unicast[0].addr_type == NET_ADDR_DHCP) {
-      if (net_addr_ntop(AF_INET,
-                        &iface->config.ip.ipv4->unicast[0].address.in_addr,
-                        ipBuffer,
-                        sizeof(ipBuffer))) {
-        // Notify the callback if it's set
-        if (Network::getInstance().callback) {
-          Network::getInstance().callback(ipBuffer);
-        }
-      } else {
-        LOG_ERR("Error while converting IP address to string form\r\n");
-      }
+  if (network.probeConflict()) {
+    LOG_WRN("%s is in use by another host, dropping the saved lease\r\n", ipBuffer);
+    k_work_cancel_delayable(&network._provisionalWork);
+    network.stopProbe();
+    network._provisional = false;
+  } else if (!net_if_is_up(network._netIface)) {
+    // Nothing goes out without a link, probing starts over once it's back
+    network._probesSent = 0;
+    k_work_schedule(&network._probeWork, K_MSEC(NETWORK_LEASE_PROBE_INTERVAL_MS));
+  } else if (network._probesSent < NETWORK_LEASE_PROBE_COUNT) {
+    if (network.sendProbe() == 0) {
+      network._probesSent++;
     }
+    k_work_schedule(&network._probeWork, (network._probesSent < NETWORK_LEASE_PROBE_COUNT) ?
+                                         K_MSEC(NETWORK_LEASE_PROBE_INTERVAL_MS) :
+                                         K_MSEC(NETWORK_LEASE_PROBE_WAIT_MS));
+  } else {
+    // Overridable, so the DHCP client takes the address over if the server hands out the same one
+    network.stopProbe();
+    net_if_ipv4_set_netmask(network._netIface, &network._lease.netmask);
+    net_if_ipv4_set_gw(network._netIface, &network._lease.gateway);
+    applied = (net_if_ipv4_addr_add(network._netIface, &network._lease.address, NET_ADDR_OVERRIDABLE, 0) != nullptr);
   }
+
+  k_mutex_unlock(&network._stateLock);
+
+  if (applied) {
+    LOG_INF("No reply to the probes, reusing %s until DHCP confirms it\r\n", ipBuffer);
+    network.update();
+  }
+}
+
+int Network::sendProbe() {
+  network_arp_frame_t frame;
+  struct net_linkaddr *linkAddress = net_if_get_link_addr(this->_netIface);
+  int ret = 0;
+
+  // Sender address all zeros, so no host caches an address that may turn out to be taken
+  memset(&frame, 0, sizeof(frame));
+  memset(frame.eth.dst.addr, 0xff, sizeof(frame.eth.dst.addr));
+  memcpy(frame.eth.src.addr, linkAddress->addr, sizeof(frame.eth.src.addr));
+  frame.eth.type = htons(NET_ETH_PTYPE_ARP);
+  frame.hwtype = htons(NETWORK_ARP_HWTYPE_ETHERNET);
+  frame.protocol = htons(NET_ETH_PTYPE_IP);
+  frame.hwlen = sizeof(struct net_eth_addr);
+  frame.protolen = sizeof(struct in_addr);
+  frame.opcode = htons(NETWORK_ARP_OP_REQUEST);
+  memcpy(frame.srcHwaddr.addr, linkAddress->addr, sizeof(frame.srcHwaddr.addr));
+  frame.dstIpaddr = this->_lease.address;
+
+  if (send(this->_probeSocket, &frame, sizeof(frame), 0) < 0) {
+    ret = -errno;
+    LOG_WRN("Failed to send an ARP probe: %d\r\n", ret);
+    return ret;
+  }
+
+  return 0;
+}
+
+bool Network::probeConflict() {
+  network_arp_frame_t frame;
+  struct net_linkaddr *linkAddress = net_if_get_link_addr(this->_netIface);
+  struct in_addr sender;
+  struct in_addr target;
+  bool conflict = false;
+
+  // Anyone using the address, or probing for it at the same time, has a better claim to it
+  while (recv(this->_probeSocket, &frame, sizeof(frame), MSG_DONTWAIT) >= (ssize_t)sizeof(frame)) {
+    if ((frame.eth.type != htons(NET_ETH_PTYPE_ARP)) ||
+        (memcmp(frame.srcHwaddr.addr, linkAddress->addr, sizeof(frame.srcHwaddr.addr)) == 0)) {
+      continue;
+    }
+    sender = frame.srcIpaddr;
+    target = frame.dstIpaddr;
+    if (net_ipv4_addr_cmp(&sender, &this->_lease.address) ||
+        ((frame.opcode == htons(NETWORK_ARP_OP_REQUEST)) && net_ipv4_is_addr_unspecified(&sender) &&
+         net_ipv4_addr_cmp(&target, &this->_lease.address))) {
+      conflict = true;
+    }
+  }
+
+  return conflict;
+}
+
+void Network::stopProbe() {
+  k_work_cancel_delayable(&this->_probeWork);
+  if (this->_probeSocket >= 0) {
+    close(this->_probeSocket);
+    this->_probeSocket = -1;
+  }
+}
+
+void Network::netMgmtCallback(struct net_mgmt_event_callback *cb, uint32_t event, struct net_if *iface) {
+  // Other interfaces don't carry the uploads
+  if (iface != Network::getInstance()._netIface) {
+    return;
+  }
+
+  if (event == NET_EVENT_IPV4_DHCP_BOUND) {
+    Network::getInstance().leaseBound();
+  }
+
+  // The events only tell something changed, the interface tells what it's like now
+  Network::getInstance().update();
 }
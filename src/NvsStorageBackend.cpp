@@ -0,0 +1,156 @@
+// Lib C includes
+#include <errno.h>
+#include <string.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/fs/nvs.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(NvsStorageBackend);
+
+// User C++ class headers
+#include "NvsStorageBackend.h"
+
+// NVS keeps the sector number in the upper half of its write addresses (ADDR_SECT_SHIFT in nvs_priv.h)
+static constexpr uint32_t NVS_ADDRESS_SECTOR_SHIFT = 16;
+
+NvsStorageBackend::NvsStorageBackend(const struct device *device, off_t offset, uint16_t sectorCount) {
+  this->device = device;
+  this->offset = offset;
+  this->sectorCount = sectorCount;
+  this->mounted = false;
+
+  memset(&this->fs, 0, sizeof(this->fs));
+  memset(&this->counters, 0, sizeof(this->counters));
+}
+
+NvsStorageBackend::~NvsStorageBackend() {
+}
+
+const char *NvsStorageBackend::name() const {
+  return "nvs";
+}
+
+int NvsStorageBackend::mount() {
+  int ret = 0;
+  struct flash_pages_info pageInfo = {0};
+
+  // Verify that the device been successfully initialized
+  if (!device_is_ready(this->device)) {
+    LOG_ERR("Flash device %s is not ready\r\n", this->device->name);
+    return -ENODEV;
+  }
+
+  // Get the size and start offset of flash page at certain flash offset
+  ret = flash_get_page_info_by_offs(this->device, this->offset, &pageInfo);
+  if (ret != 0) {
+    LOG_ERR("Unable to get page info\r\n");
+    return ret;
+  }
+
+  // Mount an NVS file system onto the flash device
+  this->fs.flash_device = this->device;
+  this->fs.offset = this->offset;
+  this->fs.sector_size = pageInfo.size;
+  this->fs.sector_count = this->sectorCount;
+  ret = nvs_mount(&this->fs);
+  if (ret != 0) {
+    LOG_ERR("Flash Init failed -(%d)\r\n", ret);
+    return ret;
+  }
+
+  this->mounted = true;
+
+  return 0;
+}
+
+ssize_t NvsStorageBackend::read(uint16_t id, void *buffer, size_t length) {
+  ssize_t ret = nvs_read(&this->fs, id, buffer, length);
+
+  this->counters.reads++;
+  if (ret > 0) {
+    this->counters.bytesRead += MIN((size_t)ret, length);
+  }
+
+  return ret;
+}
+
+ssize_t NvsStorageBackend::write(uint16_t id, const void *data, size_t length) {
+  ssize_t ret = 0;
+  uint16_t sector = this->currentSector();
+  uint32_t start = k_cycle_get_32();
+
+  ret = nvs_write(&this->fs, id, data, length);
+
+  this->counters.writes++;
+  if (ret > 0) {
+    this->counters.bytesWritten += ret;
+  }
+  this->countGc(sector, start);
+
+  return ret;
+}
+
+int NvsStorageBackend::remove(uint16_t id) {
+  uint16_t sector = this->currentSector();
+  uint32_t start = k_cycle_get_32();
+  int ret = nvs_delete(&this->fs, id);
+
+  // A deletion is written like any other entry and may trigger garbage collection as well
+  this->counters.writes++;
+  this->countGc(sector, start);
+
+  return ret;
+}
+
+int NvsStorageBackend::clear() {
+  int ret = nvs_clear(&this->fs);
+
+  // Every sector is erased and the file system has to be mounted again
+  if (ret == 0) {
+    this->counters.erases += this->fs.sector_count;
+    this->mounted = false;
+  }
+
+  return ret;
+}
+
+ssize_t NvsStorageBackend::freeSpace() {
+  return nvs_calc_free_space(&this->fs);
+}
+
+storage_backend_stats_t NvsStorageBackend::stats() const {
+  return this->counters;
+}
+
+void NvsStorageBackend::resetStats() {
+  memset(&this->counters, 0, sizeof(this->counters));
+}
+
+void NvsStorageBackend::setSectorCount(uint16_t sectorCount) {
+  this->sectorCount = sectorCount;
+}
+
+uint16_t NvsStorageBackend::currentSector() const {
+  return this->fs.ate_wra >> NVS_ADDRESS_SECTOR_SHIFT;
+}
+
+void NvsStorageBackend::countGc(uint16_t sectorBefore, uint32_t startCycles) {
+  uint32_t elapsedUs = 0;
+
+  // NVS moves to the next sector when the current one is full: it garbage collects the sector
+  // after it and erases it, so the write that crossed the boundary paid for both
+  if (!this->mounted || (this->currentSector() == sectorBefore)) {
+    return;
+  }
+
+  elapsedUs = k_cyc_to_us_floor32(k_cycle_get_32() - startCycles);
+  this->counters.erases++;
+  this->counters.gcPauses++;
+  this->counters.lastGcPauseUs = elapsedUs;
+  this->counters.maxGcPauseUs = MAX(this->counters.maxGcPauseUs, elapsedUs);
+
+  LOG_DBG("NVS moved to sector %d, garbage collection took %d us\r\n", this->currentSector(), elapsedUs);
+}
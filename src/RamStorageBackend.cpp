@@ -0,0 +1,149 @@
+// Lib C includes
+#include <errno.h>
+#include <string.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(RamStorageBackend);
+
+// User C++ class headers
+#include "RamStorageBackend.h"
+
+RamStorageBackend::RamStorageBackend(ram_storage_entry_t *entries, uint32_t entryCount) {
+  this->entries = entries;
+  this->entryCount = entryCount;
+
+  k_mutex_init(&this->mutex);
+  memset(this->entries, 0, entryCount * sizeof(ram_storage_entry_t));
+  memset(&this->counters, 0, sizeof(this->counters));
+}
+
+RamStorageBackend::~RamStorageBackend() {
+}
+
+const char *RamStorageBackend::name() const {
+  return "ram";
+}
+
+int RamStorageBackend::mount() {
+  // Nothing to scan, whatever was written since boot is still there
+  return 0;
+}
+
+ssize_t RamStorageBackend::read(uint16_t id, void *buffer, size_t length) {
+  ssize_t ret = 0;
+  ram_storage_entry_t *entry = nullptr;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  this->counters.reads++;
+
+  // Like NVS, the full entry length is returned even if the buffer is shorter
+  entry = this->find(id);
+  if (entry == nullptr) {
+    ret = -ENOENT;
+  } else {
+    memcpy(buffer, entry->data, MIN(length, entry->length));
+    this->counters.bytesRead += MIN(length, entry->length);
+    ret = entry->length;
+  }
+
+  k_mutex_unlock(&this->mutex);
+
+  return ret;
+}
+
+ssize_t RamStorageBackend::write(uint16_t id, const void *data, size_t length) {
+  ram_storage_entry_t *entry = nullptr;
+
+  if (length > RAM_STORAGE_BACKEND_ENTRY_SIZE) {
+    return -EINVAL;
+  }
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  this->counters.writes++;
+
+  entry = this->find(id);
+  if (entry == nullptr) {
+    for (uint32_t index = 0; index < this->entryCount; index++) {
+      if (!this->entries[index].valid) {
+        entry = &this->entries[index];
+        break;
+      }
+    }
+  }
+  if (entry == nullptr) {
+    k_mutex_unlock(&this->mutex);
+    return -ENOSPC;
+  }
+
+  entry->valid = true;
+  entry->id = id;
+  entry->length = length;
+  memcpy(entry->data, data, length);
+  this->counters.bytesWritten += length;
+
+  k_mutex_unlock(&this->mutex);
+
+  return length;
+}
+
+int RamStorageBackend::remove(uint16_t id) {
+  ram_storage_entry_t *entry = nullptr;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  // Deleting a missing entry succeeds, as with NVS
+  this->counters.writes++;
+  entry = this->find(id);
+  if (entry != nullptr) {
+    entry->valid = false;
+  }
+
+  k_mutex_unlock(&this->mutex);
+
+  return 0;
+}
+
+int RamStorageBackend::clear() {
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  memset(this->entries, 0, this->entryCount * sizeof(ram_storage_entry_t));
+  k_mutex_unlock(&this->mutex);
+
+  return 0;
+}
+
+ssize_t RamStorageBackend::freeSpace() {
+  ssize_t free = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  for (uint32_t index = 0; index < this->entryCount; index++) {
+    if (!this->entries[index].valid) {
+      free += RAM_STORAGE_BACKEND_ENTRY_SIZE;
+    }
+  }
+  k_mutex_unlock(&this->mutex);
+
+  return free;
+}
+
+storage_backend_stats_t RamStorageBackend::stats() const {
+  return this->counters;
+}
+
+void RamStorageBackend::resetStats() {
+  memset(&this->counters, 0, sizeof(this->counters));
+}
+
+ram_storage_entry_t *RamStorageBackend::find(uint16_t id) {
+  for (uint32_t index = 0; index < this->entryCount; index++) {
+    if (this->entries[index].valid && (this->entries[index].id == id)) {
+      return &this->entries[index];
+    }
+  }
+
+  return nullptr;
+}
@@ -0,0 +1,83 @@
+// Lib C++ includes
+#include <new>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(SampleBlock);
+
+// User C++ class headers
+#include "SampleBlock.h"
+
+// Pool the blocks come from, allocated and freed from any thread without locks
+K_MEM_SLAB_DEFINE_STATIC(sampleBlockSlab, sizeof(SampleBlock), SAMPLE_BLOCK_POOL_SIZE, alignof(SampleBlock));
+
+// Allocations refused because every block was in use
+static std::atomic<uint32_t> exhaustedCount(0);
+
+SampleBlock *SampleBlock::allocate(uint32_t sequence) {
+  void *memory = nullptr;
+
+  if (k_mem_slab_alloc(&sampleBlockSlab, &memory, K_NO_WAIT) != 0) {
+    exhaustedCount.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  return new (memory) SampleBlock(sequence);
+}
+
+SampleBlock::SampleBlock(uint32_t sequence) : references(1), taken(false) {
+  this->samples.sequence = sequence;
+  this->samples.source = SENSOR_DATA_BATCH_SOURCE_BLOCK;
+  this->samples.count = 0;
+}
+
+SampleBlock::~SampleBlock() {
+}
+
+void SampleBlock::retain() {
+  this->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SampleBlock::release() {
+  // The last holder gives the block back, whoever it is
+  if (this->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    this->~SampleBlock();
+    k_mem_slab_free(&sampleBlockSlab, this);
+  }
+}
+
+void SampleBlock::claim() {
+  this->retain();
+  this->taken = true;
+}
+
+bool SampleBlock::claimed() const {
+  return this->taken;
+}
+
+bool SampleBlock::append(const sample_t &sample) {
+  if (this->isFull()) {
+    return false;
+  }
+
+  this->samples.samples[this->samples.count++] = sample;
+
+  return true;
+}
+
+bool SampleBlock::isFull() const {
+  return this->samples.count >= SENSOR_DATA_BATCH_SIZE;
+}
+
+const sensor_data_batch_t &SampleBlock::batch() const {
+  return this->samples;
+}
+
+uint32_t SampleBlock::available() {
+  return k_mem_slab_num_free_get(&sampleBlockSlab);
+}
+
+uint32_t SampleBlock::exhausted() {
+  return exhaustedCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,239 @@
+// Lib C includes
+#include <string.h>
+
+// User C++ class headers
+#include "SampleCodec.h"
+
+// Timestamp delta-of-delta classes: '0' same period, then prefixes for wider zigzag fields
+static constexpr uint8_t CODEC_TIME_SHORT_BITS = 7;
+static constexpr uint8_t CODEC_TIME_MEDIUM_BITS = 12;
+static constexpr uint8_t CODEC_TIME_LONG_BITS = 20;
+static constexpr uint8_t CODEC_TIME_RAW_BITS = 32;
+
+// Value delta classes: '0' same value, then prefixes for wider zigzag fields, 17 bits hold any int16 delta
+static constexpr uint8_t CODEC_VALUE_SHORT_BITS = 4;
+static constexpr uint8_t CODEC_VALUE_MEDIUM_BITS = 8;
+static constexpr uint8_t CODEC_VALUE_RAW_BITS = 17;
+
+SampleCodec::SampleCodec() {
+  this->output = nullptr;
+  this->input = nullptr;
+  this->begin(0);
+}
+
+SampleCodec::~SampleCodec() {
+  // Destructor is automatically called when the object goes out of scope or is explicitly deleted
+}
+
+void SampleCodec::beginEncode(uint8_t *buffer, size_t capacity) {
+  this->output = buffer;
+  this->input = nullptr;
+  this->begin(capacity);
+}
+
+bool SampleCodec::encode(const sample_t &sample) {
+  bool fits = true;
+  size_t start = this->positionBits;
+  uint32_t dod = 0;
+  uint32_t delta = 0;
+  int32_t timeDelta = 0;
+
+  if (this->output == nullptr) {
+    return false;
+  }
+
+  if (this->samples == 0) {
+    // First sample as is
+    fits = this->writeBits((uint16_t)sample.centiDegrees, 16) &&
+           this->writeBits(sample.uptimeMs, 32) &&
+           this->writeBits(sample.status, 8);
+  } else {
+    // Sampled on a period, so the difference between two deltas is usually zero
+    timeDelta = (int32_t)(sample.uptimeMs - this->previous.uptimeMs);
+    dod = zigzag((int32_t)((uint32_t)timeDelta - (uint32_t)this->previousDelta));
+    if (dod == 0) {
+      fits = this->writeBits(0b0, 1);
+    } else if (dod < (1UL << CODEC_TIME_SHORT_BITS)) {
+      fits = this->writeBits(0b10, 2) && this->writeBits(dod, CODEC_TIME_SHORT_BITS);
+    } else if (dod < (1UL << CODEC_TIME_MEDIUM_BITS)) {
+      fits = this->writeBits(0b110, 3) && this->writeBits(dod, CODEC_TIME_MEDIUM_BITS);
+    } else if (dod < (1UL << CODEC_TIME_LONG_BITS)) {
+      fits = this->writeBits(0b1110, 4) && this->writeBits(dod, CODEC_TIME_LONG_BITS);
+    } else {
+      fits = this->writeBits(0b1111, 4) && this->writeBits(dod, CODEC_TIME_RAW_BITS);
+    }
+
+    // Temperature drifts slowly, a few hundredths of a degree at most between two samples
+    delta = zigzag((int32_t)sample.centiDegrees - (int32_t)this->previous.centiDegrees);
+    if (!fits) {
+      // Already out of room
+    } else if (delta == 0) {
+      fits = this->writeBits(0b0, 1);
+    } else if (delta < (1UL << CODEC_VALUE_SHORT_BITS)) {
+      fits = this->writeBits(0b10, 2) && this->writeBits(delta, CODEC_VALUE_SHORT_BITS);
+    } else if (delta < (1UL << CODEC_VALUE_MEDIUM_BITS)) {
+      fits = this->writeBits(0b110, 3) && this->writeBits(delta, CODEC_VALUE_MEDIUM_BITS);
+    } else {
+      fits = this->writeBits(0b111, 3) && this->writeBits(delta, CODEC_VALUE_RAW_BITS);
+    }
+
+    // Status flags hardly ever change
+    if (!fits) {
+      // Already out of room
+    } else if (sample.status == this->previous.status) {
+      fits = this->writeBits(0b0, 1);
+    } else {
+      fits = this->writeBits(0b1, 1) && this->writeBits(sample.status, 8);
+    }
+
+    if (fits) {
+      this->previousDelta = timeDelta;
+    }
+  }
+
+  // The sample is all in or not at all
+  if (!fits) {
+    this->positionBits = start;
+    return false;
+  }
+
+  this->previous = sample;
+  this->samples++;
+
+  return true;
+}
+
+size_t SampleCodec::encodedSize() const {
+  return (this->positionBits + 7) / 8;
+}
+
+void SampleCodec::beginDecode(const uint8_t *data, size_t length) {
+  this->output = nullptr;
+  this->input = data;
+  this->begin(length);
+}
+
+bool SampleCodec::decode(sample_t *sample) {
+  uint32_t prefix = 0;
+  uint32_t field = 0;
+  uint32_t value = 0;
+  uint32_t uptime = 0;
+  uint32_t status = 0;
+  uint8_t width = 0;
+
+  if (this->input == nullptr) {
+    return false;
+  }
+
+  if (this->samples == 0) {
+    if (!this->readBits(&value, 16) || !this->readBits(&uptime, 32) || !this->readBits(&status, 8)) {
+      return false;
+    }
+    this->previous.centiDegrees = (int16_t)value;
+    this->previous.uptimeMs = uptime;
+    this->previous.status = status;
+  } else {
+    // Count the leading ones of the timestamp prefix, at most 4
+    for (prefix = 0; prefix < 4; prefix++) {
+      if (!this->readBits(&field, 1)) {
+        return false;
+      }
+      if (field == 0) {
+        break;
+      }
+    }
+    static constexpr uint8_t TIME_WIDTHS[] = {0, CODEC_TIME_SHORT_BITS, CODEC_TIME_MEDIUM_BITS,
+                                              CODEC_TIME_LONG_BITS, CODEC_TIME_RAW_BITS};
+    width = TIME_WIDTHS[prefix];
+    field = 0;
+    if ((width > 0) && !this->readBits(&field, width)) {
+      return false;
+    }
+    this->previousDelta = (int32_t)((uint32_t)this->previousDelta + (uint32_t)unzigzag(field));
+    this->previous.uptimeMs += this->previousDelta;
+
+    // Same for the value prefix, at most 3
+    for (prefix = 0; prefix < 3; prefix++) {
+      if (!this->readBits(&field, 1)) {
+        return false;
+      }
+      if (field == 0) {
+        break;
+      }
+    }
+    static constexpr uint8_t VALUE_WIDTHS[] = {0, CODEC_VALUE_SHORT_BITS, CODEC_VALUE_MEDIUM_BITS,
+                                               CODEC_VALUE_RAW_BITS};
+    width = VALUE_WIDTHS[prefix];
+    field = 0;
+    if ((width > 0) && !this->readBits(&field, width)) {
+      return false;
+    }
+    this->previous.centiDegrees = (int16_t)(this->previous.centiDegrees + unzigzag(field));
+
+    if (!this->readBits(&field, 1)) {
+      return false;
+    }
+    if ((field == 1) && !this->readBits(&status, 8)) {
+      return false;
+    }
+    if (field == 1) {
+      this->previous.status = status;
+    }
+  }
+
+  *sample = this->previous;
+  this->samples++;
+
+  return true;
+}
+
+void SampleCodec::begin(size_t capacity) {
+  this->capacityBits = capacity * 8;
+  this->positionBits = 0;
+  this->samples = 0;
+  this->previousDelta = 0;
+  memset(&this->previous, 0, sizeof(this->previous));
+}
+
+bool SampleCodec::writeBits(uint32_t value, uint8_t count) {
+  if ((this->capacityBits - this->positionBits) < count) {
+    return false;
+  }
+
+  // Most significant bit first, bits are set and cleared so that a rolled back sample leaves no trace
+  for (int8_t bit = count - 1; bit >= 0; bit--) {
+    uint8_t mask = 0x80 >> (this->positionBits % 8);
+    if ((value >> bit) & 1) {
+      this->output[this->positionBits / 8] |= mask;
+    } else {
+      this->output[this->positionBits / 8] &= ~mask;
+    }
+    this->positionBits++;
+  }
+
+  return true;
+}
+
+bool SampleCodec::readBits(uint32_t *value, uint8_t count) {
+  if ((this->capacityBits - this->positionBits) < count) {
+    return false;
+  }
+
+  *value = 0;
+  for (uint8_t bit = 0; bit < count; bit++) {
+    uint8_t mask = 0x80 >> (this->positionBits % 8);
+    *value = (*value << 1) | ((this->input[this->positionBits / 8] & mask) ? 1 : 0);
+    this->positionBits++;
+  }
+
+  return true;
+}
+
+uint32_t SampleCodec::zigzag(int32_t value) {
+  // Small magnitudes of either sign map to small unsigned numbers: 0, -1, 1, -2... become 0, 1, 2, 3...
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t SampleCodec::unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
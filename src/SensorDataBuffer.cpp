@@ -0,0 +1,200 @@
+// Lib C includes
+#include <errno.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(SensorDataBuffer);
+
+// User C++ class headers
+#include "SensorDataBuffer.h"
+#include "Storage.h"
+
+// Define the static member
+SensorDataBuffer SensorDataBuffer::instance;
+
+SensorDataBuffer& SensorDataBuffer::getInstance() {
+  // Return the singleton instance
+  return instance;
+}
+
+SensorDataBuffer::SensorDataBuffer()
+  : backlog(SENSOR_DATA_BACKLOG_FIRST_ID, SENSOR_DATA_BACKLOG_SIZE, SENSOR_DATA_BACKLOG_META_ID),
+    backlogPending(0),
+    droppedCount(0),
+    spilledCount(0) {
+  k_work_init(&this->spillWork, SensorDataBuffer::spillWorkHandler);
+}
+
+SensorDataBuffer::~SensorDataBuffer() {
+}
+
+int SensorDataBuffer::push(const sample_t &sample) {
+  switch (SENSOR_DATA_BUFFER_OVERFLOW_POLICY) {
+
+    case SENSOR_DATA_OVERFLOW_DROP_OLDEST: {
+      if (this->ring.pushOverwrite(sample)) {
+        this->droppedCount.fetch_add(1, std::memory_order_relaxed);
+      }
+      return 0;
+    }
+
+    case SENSOR_DATA_OVERFLOW_DROP_NEWEST: {
+      if (!this->ring.push(sample)) {
+        this->droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return -ENOBUFS;
+      }
+      return 0;
+    }
+
+    case SENSOR_DATA_OVERFLOW_SPILL_TO_FLASH: {
+      // Once spilling started every sample goes to flash until the backlog is drained, so that
+      // the ring only ever holds samples older than the spilled ones
+      if (this->spillStaging.isEmpty() && this->spillQueue.isEmpty() &&
+          (this->backlogPending.load(std::memory_order_relaxed) == 0) && this->ring.push(sample)) {
+        return 0;
+      }
+      return this->spill(sample);
+    }
+  }
+
+  return -EINVAL;
+}
+
+int SensorDataBuffer::flushSpill() {
+  if (this->spillStaging.isEmpty()) {
+    return 0;
+  }
+
+  return this->queueSpill() ? 0 : -ENOBUFS;
+}
+
+bool SensorDataBuffer::pop(sample_t *sample) {
+  return this->ring.pop(sample);
+}
+
+uint32_t SensorDataBuffer::popMany(sample_t *samples, uint32_t count) {
+  uint32_t popped = 0;
+
+  while ((popped < count) && this->ring.pop(&samples[popped])) {
+    popped++;
+  }
+
+  return popped;
+}
+
+uint32_t SensorDataBuffer::available() const {
+  return this->ring.size();
+}
+
+int SensorDataBuffer::requeue(const sensor_data_batch_t &batch) {
+  int ret = 0;
+  BatchRecord record;
+
+  // The log numbers the record itself
+  for (uint32_t index = 0; index < batch.count; index++) {
+    record.append(batch.samples[index]);
+  }
+
+  ret = this->backlog.append(record);
+  this->refreshBacklogPending();
+
+  return ret;
+}
+
+int SensorDataBuffer::nextBacklog(sensor_data_batch_t *batch) {
+  int ret = 0;
+  BatchRecord record;
+
+  ret = this->backlog.next(&record);
+  if (ret < 0) {
+    return ret;
+  }
+
+  // Walk the record with its cursor, the batch keeps the record sequence to acknowledge it later
+  batch->sequence = record.sequence();
+  batch->source = SENSOR_DATA_BATCH_SOURCE_BACKLOG;
+  batch->count = 0;
+  while (record.next(&batch->samples[batch->count])) {
+    batch->count++;
+  }
+
+  return 0;
+}
+
+int SensorDataBuffer::ackBacklog(uint32_t sequence) {
+  int ret = this->backlog.ack(sequence);
+
+  this->refreshBacklogPending();
+
+  return ret;
+}
+
+void SensorDataBuffer::rewindBacklog() {
+  this->backlog.rewind();
+}
+
+uint32_t SensorDataBuffer::backlogged() {
+  this->refreshBacklogPending();
+
+  return this->backlog.unread();
+}
+
+uint32_t SensorDataBuffer::dropped() const {
+  return this->droppedCount.load(std::memory_order_relaxed);
+}
+
+uint32_t SensorDataBuffer::spilled() const {
+  return this->spilledCount.load(std::memory_order_relaxed);
+}
+
+int SensorDataBuffer::spill(const sample_t &sample) {
+  // A full staging record means the spill queue had no room last time, try again before giving up
+  if (this->spillStaging.isFull() && !this->queueSpill()) {
+    this->droppedCount.fetch_add(1, std::memory_order_relaxed);
+    return -ENOBUFS;
+  }
+
+  this->spillStaging.append(sample);
+  this->spilledCount.fetch_add(1, std::memory_order_relaxed);
+
+  // Samples reach flash a whole record at a time
+  if (this->spillStaging.isFull()) {
+    this->queueSpill();
+  }
+
+  return 0;
+}
+
+bool SensorDataBuffer::queueSpill() {
+  if (!this->spillQueue.push(this->spillStaging)) {
+    return false;
+  }
+  this->spillStaging.begin(0);
+
+  // Written from the normal priority work queue, the sampler goes on right away
+  Storage::getInstance().submit(&this->spillWork);
+
+  return true;
+}
+
+void SensorDataBuffer::refreshBacklogPending() {
+  this->backlogPending.store(this->backlog.pending(), std::memory_order_relaxed);
+}
+
+void SensorDataBuffer::spillWorkHandler(struct k_work *work) {
+  int ret = 0;
+  BatchRecord record;
+  SensorDataBuffer& buffer = SensorDataBuffer::getInstance();
+
+  // Every queued record in one go, a submission while this runs brings us back for the ones that follow
+  while (buffer.spillQueue.pop(&record)) {
+    ret = buffer.backlog.append(record);
+    if (ret < 0) {
+      LOG_ERR("Failed to spill %d samples to the backlog: %d\r\n", record.count(), ret);
+      buffer.droppedCount.fetch_add(record.count(), std::memory_order_relaxed);
+    }
+  }
+
+  buffer.refreshBacklogPending();
+}
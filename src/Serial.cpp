@@ -1,3 +1,7 @@
+// Lib C includes
+#include <errno.h>
+#include <string.h>
+
 // Zephyr includes
 #include <zephyr/device.h>
 #include <zephyr/drivers/uart.h>
@@ -7,21 +11,68 @@ LOG_MODULE_REGISTER(Serial);
 // User C++ class headers
 #include "Serial.h"
 
-static void serialCallback(const struct device *dev, void *userData);
+// Transmit events
+static constexpr uint32_t SERIAL_EVENT_TX_IDLE = BIT(0);
 
 Serial::Serial(const struct device *device) {
+  int ret = 0;
+
+  this->device = device;
+  this->mode = SERIAL_MODE_POLLING;
+  this->nextRxBuffer = 0;
+  this->txBusy = false;
+  this->txLength = 0;
+  this->txOffset = 0;
+  this->counters.rxBytes = 0;
+  this->counters.rxOverruns = 0;
+  this->counters.rxErrors = 0;
+  this->counters.txBytes = 0;
+  this->counters.txOverruns = 0;
+  this->counters.txErrors = 0;
+  this->counters.txQueueHighWater = 0;
+  k_sem_init(&this->rxReady, 0, 1);
+  k_mutex_init(&this->txMutex);
+  k_event_init(&this->txEvents);
+  k_event_post(&this->txEvents, SERIAL_EVENT_TX_IDLE);
+
   if (device == NULL) {
     LOG_ERR("Error: Invalid argument\r\n");
     return;
   }
 
-  this->device = device;
-
   if (!device_is_ready(this->device)) {
     LOG_ERR("Unable to get UART device\r\n");
     return;
   }
 
+  // The DMA fills a whole buffer before the CPU hears about it, or the line goes idle
+  // A DMA channel that can't be set up is no reason to lose reception, interrupts still work then
+  ret = uart_callback_set(this->device, Serial::asyncCallback, this);
+  if (ret == 0) {
+    ret = uart_rx_enable(this->device, this->rxBuffers[0], SERIAL_RX_DMA_BUFFER_SIZE, SERIAL_RX_IDLE_TIMEOUT_US);
+    if (ret == 0) {
+      this->mode = SERIAL_MODE_ASYNC;
+      this->nextRxBuffer = 1;
+      return;
+    }
+    LOG_WRN("Failed to enable UART reception (%d), falling back to interrupts\r\n", ret);
+  } else {
+    LOG_WRN("UART async API not available (%d), falling back to interrupts\r\n", ret);
+  }
+
+  ret = uart_irq_callback_user_data_set(this->device, Serial::irqCallback, this);
+  if (ret < 0) {
+    if (ret == -ENOTSUP) {
+      LOG_ERR("Interrupt-driven UART API support not enabled\r\n");
+    } else if (ret == -ENOSYS) {
+      LOG_ERR("UART device does not support interrupt-driven API\r\n");
+    } else {
+      LOG_ERR("Error setting UART callback: %d\r\n", ret);
+    }
+    return;
+  }
+
+  this->mode = SERIAL_MODE_INTERRUPT;
   uart_irq_rx_enable(this->device);
 }
 
@@ -29,88 +80,235 @@ Serial::~Serial() {
   // Destructor is automatically called when the object goes out of scope or is explicitly deleted
 }
 
-void Serial::write(uint8_t *data, uint32_t length) {
-  size_t index;
+int Serial::write(const uint8_t *data, uint32_t length) {
+  uint32_t queued = 0;
+  uint32_t depth = 0;
+  uint32_t highWater = 0;
+  k_spinlock_key_t key;
+
+  if ((data == nullptr) || (length == 0)) {
+    return -EINVAL;
+  }
 
-  if (data && length) {
-    for (index = 0; index < length; index++) {
-      uart_poll_out(this->device, *data++);
+  // Nothing to hand the bytes over to, send them right away like before
+  if (this->mode == SERIAL_MODE_POLLING) {
+    for (queued = 0; queued < length; queued++) {
+      uart_poll_out(this->device, data[queued]);
     }
+    this->counters.txBytes.fetch_add(length, std::memory_order_relaxed);
+    return length;
   }
+
+  k_mutex_lock(&this->txMutex, K_FOREVER);
+
+  // What doesn't fit is dropped rather than waited for, the caller learns it from the return value
+  queued = this->txRing.write(data, length);
+  this->counters.txOverruns.fetch_add(length - queued, std::memory_order_relaxed);
+  depth = this->txRing.size();
+  highWater = this->counters.txQueueHighWater.load(std::memory_order_relaxed);
+  while ((depth > highWater) &&
+         !this->counters.txQueueHighWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed)) {
+  }
+
+  // Start the UART if it went idle, the ISR keeps it going from then on
+  key = k_spin_lock(&this->txSpinLock);
+  if (queued > 0) {
+    k_event_clear(&this->txEvents, SERIAL_EVENT_TX_IDLE);
+    if (!this->txBusy) {
+      this->txBusy = this->transmitNext();
+    }
+  }
+  k_spin_unlock(&this->txSpinLock, key);
+
+  k_mutex_unlock(&this->txMutex);
+
+  return queued;
 }
 
-void Serial::read(uint8_t *data, uint32_t *length) {
+int Serial::flush(k_timeout_t timeout) {
+  if (k_event_wait(&this->txEvents, SERIAL_EVENT_TX_IDLE, false, timeout) == 0) {
+    return -EAGAIN;
+  }
+
+  return 0;
 }
 
-void Serial::onReceive(std::function<void(uint8_t*, uint32_t)> callback) {
-  int ret;
+void Serial::onWriteComplete(std::function<void()> callback) {
+  this->writeCompleteCallback = callback;
+}
 
+int Serial::read(uint8_t *data, uint32_t size, k_timeout_t timeout) {
+  uint32_t count = 0;
+
+  if ((data == nullptr) || (size == 0)) {
+    return -EINVAL;
+  }
+
+  // The semaphore may be left given by bytes already read, so check the ring again after every wake up
+  while ((count = this->rxRing.read(data, size)) == 0) {
+    if (k_sem_take(&this->rxReady, timeout) < 0) {
+      return -EAGAIN;
+    }
+  }
+
+  return count;
+}
+
+void Serial::onReceive(std::function<void(uint8_t*, uint32_t)> callback) {
   if (callback == nullptr) {
     LOG_ERR("Failed to register callback\r\n");
     return;
   }
 
   this->callback = callback;
+}
 
-  ret = uart_irq_callback_user_data_set(this->device, serialCallback, this);
-  if (ret < 0) {
-    if (ret == -ENOTSUP) {
-      LOG_ERR("Interrupt-driven UART API support not enabled\r\n");
-    } else if (ret == -ENOSYS) {
-      LOG_ERR("UART device does not support interrupt-driven API\r\n");
-    } else {
-      LOG_ERR("Error setting UART callback: %d\r\n", ret);
-    }
-    return;
+serial_stats_t Serial::stats() const {
+  serial_stats_t stats;
+
+  // A snapshot, counters may move while it's taken
+  stats.rxBytes = this->counters.rxBytes.load(std::memory_order_relaxed);
+  stats.rxOverruns = this->counters.rxOverruns.load(std::memory_order_relaxed);
+  stats.rxErrors = this->counters.rxErrors.load(std::memory_order_relaxed);
+  stats.txBytes = this->counters.txBytes.load(std::memory_order_relaxed);
+  stats.txOverruns = this->counters.txOverruns.load(std::memory_order_relaxed);
+  stats.txErrors = this->counters.txErrors.load(std::memory_order_relaxed);
+  stats.txQueueHighWater = this->counters.txQueueHighWater.load(std::memory_order_relaxed);
+
+  return stats;
+}
+
+void Serial::received(uint8_t *data, uint32_t length) {
+  uint32_t stored = 0;
+
+  // What doesn't fit is lost, read() isn't keeping up
+  stored = this->rxRing.write(data, length);
+  this->counters.rxBytes.fetch_add(length, std::memory_order_relaxed);
+  this->counters.rxOverruns.fetch_add(length - stored, std::memory_order_relaxed);
+
+  k_sem_give(&this->rxReady);
+
+  if (this->callback) {
+    this->callback(data, length);
   }
 }
 
-static void serialCallback(const struct device *dev, void *userData) {
-  Serial *serialInstance = nullptr;
-  uint8_t rxByte = 0;
+bool Serial::transmitNext() {
   int ret = 0;
 
-  if ((dev == nullptr) || (userData == nullptr)) {
-    LOG_ERR("Invalid callback parameters\r\n");
-    return;
+  // Bytes left in the staging buffer go first, the FIFO may not have taken them all
+  if (this->txOffset >= this->txLength) {
+    this->txLength = this->txRing.read(this->txBuffer, SERIAL_TX_DMA_BUFFER_SIZE);
+    this->txOffset = 0;
+  }
+  if (this->txLength == 0) {
+    return false;
   }
 
-  serialInstance = static_cast<Serial *>(userData);
-
-  ret = uart_irq_update(dev);
-  if (ret < 0) {
-    if (ret == -ENOSYS) {
-      LOG_ERR("uart_irq_update() function is not implemented\r\n");
-    } else if (ret == -ENOTSUP) {
-      LOG_ERR("UART API is not enabled");
+  if (this->mode == SERIAL_MODE_ASYNC) {
+    ret = uart_tx(this->device, this->txBuffer, this->txLength, SYS_FOREVER_US);
+    if (ret < 0) {
+      this->counters.txErrors.fetch_add(1, std::memory_order_relaxed);
+      this->txLength = 0;
+      return false;
     }
+  } else {
+    // Filled from the ISR as soon as the FIFO has room
+    uart_irq_tx_enable(this->device);
+  }
+
+  return true;
+}
+
+void Serial::transmitted() {
+  k_spinlock_key_t key = k_spin_lock(&this->txSpinLock);
+
+  this->txBusy = this->transmitNext();
+  if (!this->txBusy) {
+    k_event_post(&this->txEvents, SERIAL_EVENT_TX_IDLE);
+  }
+
+  k_spin_unlock(&this->txSpinLock, key);
+
+  if (!this->txBusy && this->writeCompleteCallback) {
+    this->writeCompleteCallback();
+  }
+}
+
+void Serial::asyncCallback(const struct device *dev, struct uart_event *event, void *userData) {
+  Serial *serialInstance = static_cast<Serial *>(userData);
+
+  switch (event->type) {
+    case UART_TX_DONE:
+      serialInstance->counters.txBytes.fetch_add(event->data.tx.len, std::memory_order_relaxed);
+      serialInstance->txOffset = serialInstance->txLength;
+      serialInstance->transmitted();
+      break;
+
+    case UART_TX_ABORTED:
+      // Only happens on timeout, which isn't used, the rest of the chunk is lost
+      serialInstance->counters.txErrors.fetch_add(1, std::memory_order_relaxed);
+      serialInstance->txOffset = serialInstance->txLength;
+      serialInstance->transmitted();
+      break;
+
+    case UART_RX_RDY:
+      serialInstance->received(event->data.rx.buf + event->data.rx.offset, event->data.rx.len);
+      break;
+
+    case UART_RX_BUF_REQUEST:
+      // The buffer that was released last is free again
+      uart_rx_buf_rsp(dev, serialInstance->rxBuffers[serialInstance->nextRxBuffer], SERIAL_RX_DMA_BUFFER_SIZE);
+      serialInstance->nextRxBuffer ^= 1;
+      break;
+
+    case UART_RX_STOPPED:
+      // Framing, parity or overrun error, the driver disables reception next
+      serialInstance->counters.rxErrors.fetch_add(1, std::memory_order_relaxed);
+      break;
+
+    case UART_RX_DISABLED:
+      // Keep listening whatever happened
+      uart_rx_enable(dev, serialInstance->rxBuffers[0], SERIAL_RX_DMA_BUFFER_SIZE, SERIAL_RX_IDLE_TIMEOUT_US);
+      serialInstance->nextRxBuffer = 1;
+      break;
+
+    default:
+      break;
+  }
+}
+
+void Serial::irqCallback(const struct device *dev, void *userData) {
+  Serial *serialInstance = static_cast<Serial *>(userData);
+  uint8_t chunk[16];
+  int ret = 0;
+
+  if (uart_irq_update(dev) < 0) {
     return;
   }
 
-  ret = uart_irq_rx_ready(dev);
-  if (ret < 0) {
-    if (ret == -ENOSYS) {
-      LOG_ERR("uart_irq_rx_ready() function is not implemented\r\n");
-    } else if (ret == -ENOTSUP) {
-      LOG_ERR("UART API is not enabled");
+  // Drain the whole FIFO, several bytes may have arrived since the interrupt fired
+  while (uart_irq_rx_ready(dev) > 0) {
+    ret = uart_fifo_read(dev, chunk, sizeof(chunk));
+    if (ret <= 0) {
+      break;
     }
-    return;
+    serialInstance->received(chunk, ret);
   }
 
-  ret = uart_fifo_read(dev, &rxByte, sizeof(rxByte));
-  if (ret == 1) {
-    if (serialInstance->callback) {
-      serialInstance->callback(&rxByte, ret);
+  // Fill the FIFO as far as it goes, the next interrupt comes when it has room again
+  if (serialInstance->txBusy && (uart_irq_tx_ready(dev) > 0)) {
+    if (serialInstance->txOffset < serialInstance->txLength) {
+      ret = uart_fifo_fill(dev, serialInstance->txBuffer + serialInstance->txOffset,
+                           serialInstance->txLength - serialInstance->txOffset);
+      if (ret > 0) {
+        serialInstance->txOffset += ret;
+        serialInstance->counters.txBytes.fetch_add(ret, std::memory_order_relaxed);
+      }
+    }
+    if (serialInstance->txOffset >= serialInstance->txLength) {
+      uart_irq_tx_disable(dev);
+      serialInstance->transmitted();
     }
-  } else if (ret == 0) {
-    LOG_ERR("Got a UART RX interrupt but FIFO is empty!\r\n");
-  } else if (ret > 1) {
-    LOG_ERR("Didn't expect to find more than 1 byte in FIFO!\r\n");
-  } else if (ret == -ENOSYS) {
-    LOG_ERR("uart_fifo_read() function is not implemented\r\n");
-  } else if (ret == -ENOTSUP) {
-    LOG_ERR("UART API is not enabled");
-  } else {
-    LOG_ERR("Unknown error: %d\r\n", ret);
   }
 }
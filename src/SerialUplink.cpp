@@ -0,0 +1,190 @@
+// Lib C includes
+#include <errno.h>
+#include <string.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(SerialUplink);
+
+// User C++ class headers
+#include "SerialUplink.h"
+
+// Frame delimiter, COBS guarantees it never shows up inside a frame
+static constexpr uint8_t SERIAL_UPLINK_DELIMITER = 0x00;
+
+SerialUplink::SerialUplink(const struct device *device) : serial(device) {
+  this->sequence = 0;
+  this->receivedLength = 0;
+  sys_rand_get(&this->session, sizeof(this->session));
+  memset(&this->statistics, 0, sizeof(this->statistics));
+}
+
+SerialUplink::~SerialUplink() {
+  // Destructor is automatically called when the object goes out of scope or is explicitly deleted
+}
+
+int SerialUplink::send(const sensor_data_batch_t &batch) {
+  uint32_t length = 0;
+  uint32_t encodedLength = 0;
+  uint32_t count = MIN(batch.count, BATCH_RECORD_MAX_SAMPLES);
+  uint16_t crc = 0;
+
+  // Header
+  this->sequence++;
+  this->frame[length++] = SERIAL_UPLINK_FRAME_DATA;
+  sys_put_le16(this->session, &this->frame[length]);
+  length += sizeof(uint16_t);
+  sys_put_le16(this->sequence, &this->frame[length]);
+  length += sizeof(uint16_t);
+
+  // Payload, samples are packed and the target is little endian so they go out as they are
+  sys_put_le32(batch.sequence, &this->frame[length]);
+  length += sizeof(uint32_t);
+  this->frame[length++] = batch.source;
+  this->frame[length++] = count;
+  memcpy(&this->frame[length], batch.samples, count * sizeof(sample_t));
+  length += count * sizeof(sample_t);
+
+  crc = crc16_ccitt(0xFFFF, this->frame, length);
+  sys_put_le16(crc, &this->frame[length]);
+  length += sizeof(uint16_t);
+
+  // Leading delimiter too, whatever garbage the receiver holds is flushed before the frame
+  this->encoded[0] = SERIAL_UPLINK_DELIMITER;
+  encodedLength = 1 + SerialUplink::cobsEncode(this->frame, length, &this->encoded[1]);
+  this->encoded[encodedLength++] = SERIAL_UPLINK_DELIMITER;
+
+  // Stop-and-wait, the same frame with the same sequence number until it's acknowledged
+  for (uint32_t attempt = 0; attempt <= SERIAL_UPLINK_MAX_RETRANSMIT; attempt++) {
+    if (attempt > 0) {
+      this->statistics.retransmissions++;
+      LOG_WRN("No ack for frame %d, retransmitting\r\n", this->sequence);
+    }
+
+    if (this->serial.write(this->encoded, encodedLength) < (int)encodedLength) {
+      LOG_WRN("Serial queue full, frame %d truncated\r\n", this->sequence);
+    }
+    this->statistics.framesSent++;
+
+    if (this->waitForAck(this->sequence, SERIAL_UPLINK_ACK_TIMEOUT_MS)) {
+      this->statistics.acknowledged++;
+      return 0;
+    }
+  }
+
+  return -ETIMEDOUT;
+}
+
+serial_uplink_stats_t SerialUplink::stats() const {
+  return this->statistics;
+}
+
+bool SerialUplink::waitForAck(uint16_t sequence, int32_t timeoutMs) {
+  uint8_t chunk[16];
+  uint8_t decoded[SERIAL_UPLINK_MAX_ENCODED];
+  int64_t deadline = k_uptime_get() + timeoutMs;
+  int64_t remaining = 0;
+  int length = 0;
+  int decodedLength = 0;
+
+  while ((remaining = deadline - k_uptime_get()) > 0) {
+    length = this->serial.read(chunk, sizeof(chunk), K_MSEC(remaining));
+    if (length < 0) {
+      return false;
+    }
+
+    for (int index = 0; index < length; index++) {
+      if (chunk[index] != SERIAL_UPLINK_DELIMITER) {
+        // Longer than any frame, it's noise, wait for the next delimiter
+        if (this->receivedLength < sizeof(this->received)) {
+          this->received[this->receivedLength] = chunk[index];
+        }
+        this->receivedLength++;
+        continue;
+      }
+
+      // Back to back delimiters are just idle line
+      if (this->receivedLength == 0) {
+        continue;
+      }
+
+      decodedLength = -EINVAL;
+      if (this->receivedLength <= sizeof(this->received)) {
+        decodedLength = SerialUplink::cobsDecode(this->received, this->receivedLength, decoded);
+      }
+      this->receivedLength = 0;
+
+      if ((decodedLength != (int)(SERIAL_UPLINK_HEADER_SIZE + SERIAL_UPLINK_CRC_SIZE)) ||
+          (decoded[0] != SERIAL_UPLINK_FRAME_ACK) ||
+          (crc16_ccitt(0xFFFF, decoded, SERIAL_UPLINK_HEADER_SIZE) != sys_get_le16(&decoded[SERIAL_UPLINK_HEADER_SIZE]))) {
+        this->statistics.badFrames++;
+        continue;
+      }
+
+      // Acks of earlier retransmissions may still come in, they're simply ignored
+      if ((sys_get_le16(&decoded[1]) == this->session) && (sys_get_le16(&decoded[3]) == sequence)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+uint32_t SerialUplink::cobsEncode(const uint8_t *data, uint32_t length, uint8_t *output) {
+  uint32_t codeIndex = 0;
+  uint32_t outputLength = 1;
+  uint8_t code = 1;
+
+  // Every zero is replaced by the distance to the next one, runs of 254 non-zero bytes get their own code
+  for (uint32_t index = 0; index < length; index++) {
+    if (data[index] == 0) {
+      output[codeIndex] = code;
+      codeIndex = outputLength++;
+      code = 1;
+      continue;
+    }
+
+    output[outputLength++] = data[index];
+    code++;
+    if (code == 0xFF) {
+      output[codeIndex] = code;
+      codeIndex = outputLength++;
+      code = 1;
+    }
+  }
+  output[codeIndex] = code;
+
+  return outputLength;
+}
+
+int SerialUplink::cobsDecode(const uint8_t *data, uint32_t length, uint8_t *output) {
+  uint32_t index = 0;
+  uint32_t outputLength = 0;
+  uint8_t code = 0;
+
+  while (index < length) {
+    code = data[index++];
+    if (code == 0) {
+      return -EINVAL;
+    }
+
+    for (uint8_t copied = 1; copied < code; copied++) {
+      if (index >= length) {
+        return -EINVAL;
+      }
+      output[outputLength++] = data[index++];
+    }
+
+    // A full run isn't followed by an implicit zero, nor is the last block
+    if ((code < 0xFF) && (index < length)) {
+      output[outputLength++] = 0;
+    }
+  }
+
+  return outputLength;
+}
@@ -1,16 +1,76 @@
+// Lib C includes
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
 // Zephyr includes
+#include <zephyr/kernel.h>
 #include <zephyr/drivers/flash.h>
 #include <zephyr/storage/flash_map.h>
-#include <zephyr/fs/nvs.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/shell/shell.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(Storage);
 
 // User C++ class headers
 #include "Storage.h"
+#include "NvsStorageBackend.h"
+#include "RamStorageBackend.h"
+#include "SensorDataBuffer.h"
+#include "EventManager.h"
+#include "ActiveObject.h"
 
 #define NVS_PARTITION_DEVICE FIXED_PARTITION_DEVICE(storage_partition)
 #define NVS_PARTITION_OFFSET FIXED_PARTITION_OFFSET(storage_partition)
 
+// Benchmarking NVS wipes the partition it runs on, so it needs a spare one labelled bench_partition
+#define BENCH_PARTITION_AVAILABLE FIXED_PARTITION_EXISTS(bench_partition)
+
+// Benchmark defaults, records cycle over a few ids so that NVS has to garbage collect old values
+static constexpr uint16_t STORAGE_BENCH_FIRST_ID = 0x1000;
+static constexpr uint16_t STORAGE_BENCH_IDS = 16;
+static constexpr uint32_t STORAGE_BENCH_MAX_RECORD_SIZE = 256;
+static constexpr uint16_t STORAGE_BENCH_MIN_SECTORS = 2;
+static constexpr uint16_t STORAGE_BENCH_DEFAULT_SECTORS = 2;
+static constexpr uint32_t STORAGE_BENCH_DEFAULT_RECORD_SIZE = BatchRecord::capacity();
+static constexpr uint32_t STORAGE_BENCH_DEFAULT_RECORDS = 1000;
+
+// Codec check series, from the best case for the compressor to one it can't do anything with
+typedef enum {
+  STORAGE_CODEC_SERIES_STEADY = 0,
+  STORAGE_CODEC_SERIES_NOISY,
+  STORAGE_CODEC_SERIES_LARGE_DELTAS,
+  STORAGE_CODEC_SERIES_RANDOM,
+  STORAGE_CODEC_SERIES_COUNT,
+} storage_codec_series_t;
+
+static const char *const STORAGE_CODEC_SERIES_NAMES[STORAGE_CODEC_SERIES_COUNT] = {
+  "steady", "noisy", "large deltas", "random",
+};
+
+// Codec check defaults, the series are generated from a fixed seed so every run checks the same records
+static constexpr uint32_t STORAGE_CODEC_DEFAULT_RECORDS = 1000;
+static constexpr uint32_t STORAGE_CODEC_SEED = 0x2545F491;
+
+// Posted on the Storage events once the mount attempt is over, successful or not
+#define STORAGE_EVENT_MOUNTED BIT(0)
+
+// RAM backend entries when it is the one selected: the whole backlog, its meta entry and a few settings
+static constexpr uint32_t STORAGE_RAM_BACKEND_ENTRIES = SENSOR_DATA_BACKLOG_SIZE + 8;
+
+// Only the backend selected by STORAGE_BACKEND is built, the other one takes no RAM
+static StorageBackend *selectedBackend() {
+  if constexpr (STORAGE_BACKEND == STORAGE_BACKEND_RAM) {
+    static ram_storage_entry_t ramEntries[STORAGE_RAM_BACKEND_ENTRIES];
+    static RamStorageBackend ramBackend(ramEntries, ARRAY_SIZE(ramEntries));
+    return &ramBackend;
+  } else {
+    static NvsStorageBackend nvsBackend(NVS_PARTITION_DEVICE, NVS_PARTITION_OFFSET, STORAGE_SECTOR_COUNT);
+    return &nvsBackend;
+  }
+}
+
 // Define the static member
 Storage Storage::instance;
 
@@ -20,33 +80,24 @@ Storage& Storage::getInstance() {
 }
 
 Storage::Storage() {
-  int ret = 0;
-  struct flash_pages_info pageInfo = {0};
-
-  // Verify that the device been successfully initialized
-  this->fs.flash_device = NVS_PARTITION_DEVICE;
-  ret = device_is_ready(this->fs.flash_device);
-  if (ret == 0) {
-    LOG_ERR("Flash device %s is not ready\r\n", this->fs.flash_device->name);
-    return;
-  }
+  // The cache is usable even if mounting fails, flushing will then fail and keep the entries dirty
+  k_mutex_init(&this->mutex);
+  memset(this->cache, 0, sizeof(this->cache));
+  memset(&this->stats, 0, sizeof(this->stats));
+  this->cacheClock = 0;
+  this->dirtyCount = 0;
+  k_work_init_delayable(&this->flushWork, Storage::flushWorkHandler);
 
-  // Get the size and start offset of flash page at certain flash offset
-  this->fs.offset = NVS_PARTITION_OFFSET;
-  ret = flash_get_page_info_by_offs(this->fs.flash_device, this->fs.offset, &pageInfo);
-  if (ret != 0) {
-    LOG_ERR("Unable to get page inf>>o\r\n");
-    return;
-  }
+  this->store = selectedBackend();
 
-  // Mount an NVS file system onto the flash device
-  this->fs.sector_size = pageInfo.size;
-  this->fs.sector_count = 2U;
-  ret = nvs_mount(&this->fs);
-  if (ret != 0) {
-    LOG_ERR("Flash Init failed -(%d)\r\n", ret);
-    return;
-  }
+  // Scanning the partition takes a while, leave it to a work queue so boot goes on. Submitted before any
+  // event can be published, so handlers on the same queue that wait for the mount always find it done.
+  k_event_init(&this->events);
+  this->mountResult = -EAGAIN;
+  this->mountDurationMs = 0;
+  k_work_init(&this->mountWork, Storage::mountWorkHandler);
+  this->workQueue = ActiveObject::queueOf(ACTIVE_OBJECT_PRIORITY_NORMAL);
+  k_work_submit_to_queue(this->workQueue, &this->mountWork);
 }
 
 Storage::~Storage() {
@@ -54,18 +105,87 @@ Storage::~Storage() {
 
 int Storage::read(uint16_t id, void *buffer, size_t length) {
   int ret = 0;
+  struct cacheEntry *entry = nullptr;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  // Recently written entries are served from RAM, like NVS the full entry length is returned
+  entry = this->cacheFind(id);
+  if (entry != nullptr) {
+    memcpy(buffer, entry->data, MIN(length, entry->length));
+    entry->lastUsed = ++this->cacheClock;
+    this->stats.hits++;
+    k_mutex_unlock(&this->mutex);
+    return entry->length;
+  }
+  this->stats.misses++;
 
   // Read an entry by its id from the NVS file system
-  ret = nvs_read(&this->fs, id, buffer, sizeof(buffer));
+  ret = this->waitMounted();
+  if (ret == 0) {
+    ret = this->store->read(id, buffer, length);
+  }
+
+  k_mutex_unlock(&this->mutex);
 
   return ret;
 }
 
-int Storage::write(uint16_t id, void *data, size_t length) {
+int Storage::write(uint16_t id, void *data, size_t length, bool durable) {
   int ret = 0;
+  struct cacheEntry *entry = nullptr;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  if (STORAGE_CACHE_ENABLED && !durable && (length <= STORAGE_CACHE_ENTRY_SIZE)) {
+    entry = this->cacheFind(id);
+    if (entry == nullptr) {
+      entry = this->cacheAllocate();
+    }
+
+    if (entry != nullptr) {
+      // Rewriting a dirty entry replaces it in RAM, only the last value reaches flash
+      if (entry->valid && entry->dirty) {
+        this->stats.coalesced++;
+      } else {
+        this->dirtyCount++;
+      }
+
+      entry->valid = true;
+      entry->dirty = true;
+      entry->id = id;
+      entry->length = length;
+      entry->lastUsed = ++this->cacheClock;
+      entry->lastWritten = entry->lastUsed;
+      memcpy(entry->data, data, length);
+
+      // Over budget: flush now from the writing thread, otherwise the timer flushes later
+      if (this->dirtyCount >= STORAGE_CACHE_HIGH_WATER) {
+        this->flush();
+      } else {
+        k_work_schedule_for_queue(this->workQueue, &this->flushWork, K_MSEC(STORAGE_CACHE_FLUSH_PERIOD_MS));
+      }
+
+      k_mutex_unlock(&this->mutex);
+      return length;
+    }
+  }
+
+  // Written through, a cached copy (even a pending one) would now be stale
+  entry = this->cacheFind(id);
+  if (entry != nullptr) {
+    if (entry->dirty) {
+      this->dirtyCount--;
+    }
+    entry->valid = false;
+    entry->dirty = false;
+  }
 
   // Write an entry by its id to the NVS file system
-  ret = nvs_write(&this->fs, id, data, sizeof(data));
+  ret = this->waitMounted();
+  if (ret == 0) {
+    ret = this->store->write(id, data, length);
+  }
   if (ret > 0) {
     LOG_DBG("%d bytes written to NVS\r\n", ret);
   } else if (ret == 0) {
@@ -74,14 +194,78 @@ int Storage::write(uint16_t id, void *data, size_t length) {
     LOG_ERR("Failed to write to NVS: -(%d)\r\n", ret);
   }
 
+  k_mutex_unlock(&this->mutex);
+
+  return ret;
+}
+
+int Storage::readBatch(uint16_t id, BatchRecord *record) {
+  int ret = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  // Returns the length of the stored entry, which may be shorter than the record capacity
+  ret = this->read(id, this->batchBuffer, sizeof(this->batchBuffer));
+  if (ret < 0) {
+    k_mutex_unlock(&this->mutex);
+    LOG_DBG("Failed to read batch record with id %d from NVS: -(%d)\r\n", id, ret);
+    return ret;
+  }
+
+  // Check the header against the length and the CRC, decompress, then rewind the cursor
+  ret = record->decode(this->batchBuffer, MIN((size_t)ret, sizeof(this->batchBuffer)));
+
+  k_mutex_unlock(&this->mutex);
+
   return ret;
 }
 
+int Storage::writeBatch(uint16_t id, BatchRecord &record, bool durable) {
+  int ret = 0;
+  size_t length = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  // The header and all the samples go in a single entry behind a single allocation table entry
+  length = record.encode(this->batchBuffer, sizeof(this->batchBuffer));
+  this->stats.batchBytesRaw += record.size();
+  this->stats.batchBytesStored += length;
+  ret = this->write(id, this->batchBuffer, length, durable);
+
+  k_mutex_unlock(&this->mutex);
+
+  if (ret < 0) {
+    LOG_ERR("Failed to write batch record %d to NVS: -(%d)\r\n", record.sequence(), ret);
+    return ret;
+  }
+
+  LOG_DBG("Batch record %d with %d samples written to NVS in %d bytes\r\n", record.sequence(), record.count(), (int)length);
+
+  return 0;
+}
+
 int Storage::remove(uint16_t id) {
   int ret = 0;
+  struct cacheEntry *entry = nullptr;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  // A pending write of the entry is simply forgotten
+  entry = this->cacheFind(id);
+  if (entry != nullptr) {
+    if (entry->dirty) {
+      this->dirtyCount--;
+    }
+    entry->valid = false;
+    entry->dirty = false;
+  }
 
   // Delete an entry from the NVS file system
-  ret = nvs_delete(&this->fs, id);
+  ret = this->waitMounted();
+  if (ret == 0) {
+    ret = this->store->remove(id);
+  }
+  k_mutex_unlock(&this->mutex);
   if (ret == 0) {
     LOG_DBG("Entry with id %d is deleted from NVS\r\n", id);
   } else {
@@ -94,8 +278,18 @@ int Storage::remove(uint16_t id) {
 int Storage::clear() {
   int ret = 0;
 
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  // Pending writes are dropped with everything else
+  memset(this->cache, 0, sizeof(this->cache));
+  this->dirtyCount = 0;
+
   // Clear the NVS file system from flash
-  ret = nvs_clear(&this->fs);
+  ret = this->waitMounted();
+  if (ret == 0) {
+    ret = this->store->clear();
+  }
+  k_mutex_unlock(&this->mutex);
   if (ret == 0) {
     LOG_DBG("NVS file system is cleared from flash\r\n");
   } else {
@@ -104,3 +298,480 @@ int Storage::clear() {
 
   return ret;
 }
+
+int Storage::sync() {
+  int ret = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  ret = this->flush();
+  k_mutex_unlock(&this->mutex);
+
+  return ret;
+}
+
+bool Storage::isReady() {
+  return this->waitUntilReady(K_NO_WAIT) == 0;
+}
+
+int Storage::waitUntilReady(k_timeout_t timeout) {
+  if (k_event_wait(&this->events, STORAGE_EVENT_MOUNTED, false, timeout) == 0) {
+    return -EAGAIN;
+  }
+
+  return this->mountResult;
+}
+
+uint32_t Storage::mountTimeMs() const {
+  return this->mountDurationMs;
+}
+
+void Storage::submit(struct k_work *work) {
+  k_work_submit_to_queue(this->workQueue, work);
+}
+
+StorageBackend& Storage::backend() {
+  return *this->store;
+}
+
+storage_cache_stats_t Storage::cacheStats() {
+  storage_cache_stats_t stats;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  stats = this->stats;
+  k_mutex_unlock(&this->mutex);
+
+  return stats;
+}
+
+struct Storage::cacheEntry *Storage::cacheFind(uint16_t id) {
+  for (uint32_t index = 0; index < STORAGE_CACHE_ENTRIES; index++) {
+    if (this->cache[index].valid && (this->cache[index].id == id)) {
+      return &this->cache[index];
+    }
+  }
+
+  return nullptr;
+}
+
+struct Storage::cacheEntry *Storage::cacheAllocate() {
+  struct cacheEntry *victim = nullptr;
+
+  // A free entry, or else the least recently used clean one
+  for (uint32_t index = 0; index < STORAGE_CACHE_ENTRIES; index++) {
+    if (!this->cache[index].valid) {
+      return &this->cache[index];
+    }
+    if (!this->cache[index].dirty && ((victim == nullptr) || (this->cache[index].lastUsed < victim->lastUsed))) {
+      victim = &this->cache[index];
+    }
+  }
+  if (victim != nullptr) {
+    victim->valid = false;
+    return victim;
+  }
+
+  // Everything is dirty, make room the slow way
+  if (this->flush() < 0) {
+    return nullptr;
+  }
+
+  return this->cacheAllocate();
+}
+
+int Storage::waitMounted() {
+  // Callers queue up here until the normal priority work queue is done mounting, the mutex may be held
+  // meanwhile since mounting never takes it
+  return this->waitUntilReady(K_FOREVER);
+}
+
+int Storage::flush() {
+  int ret = 0;
+  uint32_t start = 0;
+  uint32_t flushed = 0;
+  uint32_t elapsedUs = 0;
+  struct cacheEntry *oldest = nullptr;
+
+  if (this->dirtyCount == 0) {
+    return 0;
+  }
+
+  ret = this->waitMounted();
+  if (ret < 0) {
+    return ret;
+  }
+
+  k_work_cancel_delayable(&this->flushWork);
+  start = k_cycle_get_32();
+
+  // In the order they were written, so that an entry never reaches flash before an older one
+  // (a time series log record is always written before the pointer that references it)
+  do {
+    oldest = nullptr;
+    for (uint32_t index = 0; index < STORAGE_CACHE_ENTRIES; index++) {
+      if (this->cache[index].valid && this->cache[index].dirty &&
+          ((oldest == nullptr) || (this->cache[index].lastWritten < oldest->lastWritten))) {
+        oldest = &this->cache[index];
+      }
+    }
+
+    if (oldest != nullptr) {
+      ret = this->store->write(oldest->id, oldest->data, oldest->length);
+      if (ret < 0) {
+        LOG_ERR("Failed to flush entry with id %d to NVS: -(%d)\r\n", oldest->id, ret);
+        k_work_schedule_for_queue(this->workQueue, &this->flushWork, K_MSEC(STORAGE_CACHE_FLUSH_PERIOD_MS));
+        break;
+      }
+      oldest->dirty = false;
+      this->dirtyCount--;
+      flushed++;
+    }
+  } while (oldest != nullptr);
+
+  elapsedUs = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+  this->stats.flushes++;
+  this->stats.flushedEntries += flushed;
+  this->stats.lastFlushUs = elapsedUs;
+  this->stats.maxFlushUs = MAX(this->stats.maxFlushUs, elapsedUs);
+
+  LOG_DBG("%d cached entries flushed to NVS in %d us\r\n", flushed, elapsedUs);
+
+  return (ret < 0) ? ret : flushed;
+}
+
+void Storage::mountWorkHandler(struct k_work *work) {
+  int64_t start = k_uptime_get();
+  event_t event = {.id = EVENT_STORAGE_READY};
+  Storage& storage = Storage::getInstance();
+
+  // Submitted first to the normal priority work queue, a flush can't reach NVS before it
+  storage.mountResult = storage.store->mount();
+  storage.mountDurationMs = (uint32_t)(k_uptime_get() - start);
+  k_event_post(&storage.events, STORAGE_EVENT_MOUNTED);
+
+  if (storage.mountResult != 0) {
+    LOG_ERR("Storage mount failed after %d ms: -(%d)\r\n", storage.mountDurationMs, storage.mountResult);
+    return;
+  }
+
+  LOG_INF("Storage mounted on %s in %d ms, %d bytes free\r\n",
+          storage.store->name(),
+          storage.mountDurationMs,
+          (int)storage.store->freeSpace());
+
+  // Publish the <EVENT_STORAGE_READY> event on <controlChannel>
+  eventPublish(event, K_MSEC(EVENT_PUBLISH_TIMEOUT_MS));
+}
+
+void Storage::flushWorkHandler(struct k_work *work) {
+  // Runs on the normal priority work queue once the oldest dirty entry is old enough
+  Storage::getInstance().sync();
+}
+
+static int storageStatsCommand(const struct shell *shell, size_t argc, char **argv) {
+  Storage& storage = Storage::getInstance();
+  storage_cache_stats_t stats = storage.cacheStats();
+  storage_backend_stats_t backendStats = storage.backend().stats();
+  uint32_t lookups = stats.hits + stats.misses;
+
+  if (storage.isReady()) {
+    shell_print(shell, "Mounted in %u ms", storage.mountTimeMs());
+  } else {
+    shell_print(shell, "Not mounted");
+  }
+
+  shell_print(shell, "Cache hits: %u/%u (%u%%)", stats.hits, lookups, lookups ? (stats.hits * 100) / lookups : 0);
+  shell_print(shell, "Coalesced writes: %u", stats.coalesced);
+  shell_print(shell, "Flushes: %u, %u entries", stats.flushes, stats.flushedEntries);
+  shell_print(shell, "Flush latency: last %u us, max %u us", stats.lastFlushUs, stats.maxFlushUs);
+  shell_print(shell, "Batch records: %u bytes stored for %u bytes of samples (%u%%)",
+              stats.batchBytesStored,
+              stats.batchBytesRaw,
+              stats.batchBytesRaw ? (uint32_t)(((uint64_t)stats.batchBytesStored * 100) / stats.batchBytesRaw) : 0);
+  shell_print(shell, "Backend %s: %u erases, %u GC pauses, max %u us",
+              storage.backend().name(), backendStats.erases, backendStats.gcPauses, backendStats.maxGcPauseUs);
+
+  return 0;
+}
+
+static uint32_t perSecond(uint64_t amount, uint64_t elapsedUs) {
+  return elapsedUs ? (uint32_t)((amount * USEC_PER_SEC) / elapsedUs) : 0;
+}
+
+static int storageBenchCommand(const struct shell *shell, size_t argc, char **argv) {
+  int ret = 0;
+  uint32_t sectors = (argc > 2) ? strtoul(argv[2], NULL, 0) : STORAGE_BENCH_DEFAULT_SECTORS;
+  uint32_t recordSize = (argc > 3) ? strtoul(argv[3], NULL, 0) : STORAGE_BENCH_DEFAULT_RECORD_SIZE;
+  uint32_t records = (argc > 4) ? strtoul(argv[4], NULL, 0) : STORAGE_BENCH_DEFAULT_RECORDS;
+  uint32_t maxRecordSize = STORAGE_BENCH_MAX_RECORD_SIZE;
+  uint8_t record[STORAGE_BENCH_MAX_RECORD_SIZE] = {0};
+  uint64_t writeUs = 0;
+  uint64_t readUs = 0;
+  int64_t start = 0;
+  StorageBackend *backend = nullptr;
+  storage_backend_stats_t stats;
+
+  // Scratch backends, never the one Storage is using. The RAM one only needs the ids the bench cycles over
+  static ram_storage_entry_t ramScratchEntries[STORAGE_BENCH_IDS];
+  static RamStorageBackend ramScratch(ramScratchEntries, ARRAY_SIZE(ramScratchEntries));
+#if BENCH_PARTITION_AVAILABLE
+  static NvsStorageBackend nvsScratch(FIXED_PARTITION_DEVICE(bench_partition),
+                                      FIXED_PARTITION_OFFSET(bench_partition),
+                                      STORAGE_BENCH_DEFAULT_SECTORS);
+  struct flash_pages_info pageInfo = {0};
+#endif
+
+  if (strcmp(argv[1], "ram") == 0) {
+    maxRecordSize = MIN(maxRecordSize, RAM_STORAGE_BACKEND_ENTRY_SIZE);
+    backend = &ramScratch;
+  } else if (strcmp(argv[1], "nvs") == 0) {
+#if BENCH_PARTITION_AVAILABLE
+    // NVS needs two sectors at least, and must not run past the end of the partition
+    ret = flash_get_page_info_by_offs(FIXED_PARTITION_DEVICE(bench_partition),
+                                      FIXED_PARTITION_OFFSET(bench_partition), &pageInfo);
+    if (ret != 0) {
+      shell_error(shell, "Unable to get the bench_partition page info: %d", ret);
+      return ret;
+    }
+    if ((sectors < STORAGE_BENCH_MIN_SECTORS) ||
+        (((uint64_t)sectors * pageInfo.size) > FIXED_PARTITION_SIZE(bench_partition))) {
+      shell_error(shell, "Sectors must be %u to %u", STORAGE_BENCH_MIN_SECTORS,
+                  (unsigned)(FIXED_PARTITION_SIZE(bench_partition) / pageInfo.size));
+      return -EINVAL;
+    }
+    nvsScratch.setSectorCount(sectors);
+    backend = &nvsScratch;
+#else
+    shell_error(shell, "No bench_partition in the devicetree");
+    return -ENODEV;
+#endif
+  } else {
+    shell_error(shell, "Unknown backend: %s", argv[1]);
+    return -EINVAL;
+  }
+
+  if ((recordSize == 0) || (recordSize > maxRecordSize) || (records == 0)) {
+    shell_error(shell, "Record size must be 1 to %u bytes on %s, with at least one record",
+                maxRecordSize, backend->name());
+    return -EINVAL;
+  }
+
+  // Start from an empty backend, NVS has to be mounted to be cleared and again afterwards
+  ret = backend->mount();
+  if (ret == 0) {
+    ret = backend->clear();
+  }
+  if (ret == 0) {
+    ret = backend->mount();
+  }
+  if (ret < 0) {
+    shell_error(shell, "Failed to prepare the %s backend: %d", backend->name(), ret);
+    return ret;
+  }
+  backend->resetStats();
+
+  shell_print(shell, "%s: %u records of %u bytes over %u ids, %u sectors",
+              backend->name(), records, recordSize, STORAGE_BENCH_IDS, sectors);
+
+  start = k_uptime_ticks();
+  for (uint32_t index = 0; index < records; index++) {
+    // Different content every time, NVS skips writing a value identical to the stored one
+    memset(record, (uint8_t)index, recordSize);
+    ret = backend->write(STORAGE_BENCH_FIRST_ID + (index % STORAGE_BENCH_IDS), record, recordSize);
+    if (ret < 0) {
+      shell_error(shell, "Write %u failed: %d", index, ret);
+      return ret;
+    }
+  }
+  writeUs = k_ticks_to_us_floor64(k_uptime_ticks() - start);
+
+  start = k_uptime_ticks();
+  for (uint32_t index = 0; index < records; index++) {
+    ret = backend->read(STORAGE_BENCH_FIRST_ID + (index % STORAGE_BENCH_IDS), record, recordSize);
+    if (ret < 0) {
+      shell_error(shell, "Read %u failed: %d", index, ret);
+      return ret;
+    }
+  }
+  readUs = k_ticks_to_us_floor64(k_uptime_ticks() - start);
+
+  stats = backend->stats();
+  shell_print(shell, "Writes: %u ops/s, %u bytes/s",
+              perSecond(stats.writes, writeUs), perSecond(stats.bytesWritten, writeUs));
+  shell_print(shell, "Reads: %u ops/s, %u bytes/s",
+              perSecond(stats.reads, readUs), perSecond(stats.bytesRead, readUs));
+  shell_print(shell, "Erases: %u", stats.erases);
+  shell_print(shell, "GC pauses: %u, last %u us, max %u us", stats.gcPauses, stats.lastGcPauseUs, stats.maxGcPauseUs);
+  shell_print(shell, "Free space left: %d bytes", (int)backend->freeSpace());
+
+  return 0;
+}
+
+static uint32_t nextRandom(uint32_t *state) {
+  // xorshift32, deterministic so a failing record can be reproduced
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+
+  return *state;
+}
+
+static sample_t codecSample(storage_codec_series_t series, const sample_t &previous, uint32_t index, uint32_t *random) {
+  sample_t sample = previous;
+
+  switch (series) {
+
+    case STORAGE_CODEC_SERIES_STEADY: {
+      // Fixed period, the temperature drifting by a hundredth now and then
+      sample.uptimeMs += 1000;
+      sample.centiDegrees += ((index % 4) == 0) ? 1 : 0;
+      break;
+    }
+
+    case STORAGE_CODEC_SERIES_NOISY: {
+      // Scheduling jitter, sensor noise and a read error from time to time
+      sample.uptimeMs += 997 + (nextRandom(random) % 7);
+      sample.centiDegrees += (int16_t)(nextRandom(random) % 41) - 20;
+      sample.status = ((nextRandom(random) % 32) == 0) ? SAMPLE_STATUS_READ_ERROR : SAMPLE_STATUS_OK;
+      break;
+    }
+
+    case STORAGE_CODEC_SERIES_LARGE_DELTAS: {
+      // A reboot sized gap (uptime wrapping included) and a full scale swing every fourth sample
+      if ((index % 4) == 3) {
+        sample.uptimeMs += (1UL << 20) + (nextRandom(random) % (1UL << 28));
+        sample.centiDegrees = (sample.centiDegrees < 0) ? INT16_MAX : INT16_MIN;
+        sample.status ^= SAMPLE_STATUS_OUT_OF_RANGE;
+      } else {
+        sample.uptimeMs += 1000;
+      }
+      break;
+    }
+
+    case STORAGE_CODEC_SERIES_RANDOM:
+    default: {
+      // Nothing in common between two samples, every record has to fall back to raw
+      sample.uptimeMs = nextRandom(random);
+      sample.centiDegrees = (int16_t)nextRandom(random);
+      sample.status = (uint8_t)nextRandom(random);
+      break;
+    }
+  }
+
+  return sample;
+}
+
+static int storageCodecCommand(const struct shell *shell, size_t argc, char **argv) {
+  int ret = 0;
+  uint32_t records = (argc > 1) ? strtoul(argv[1], NULL, 0) : STORAGE_CODEC_DEFAULT_RECORDS;
+  uint32_t seed = STORAGE_CODEC_SEED;
+  uint32_t start = 0;
+  uint32_t samples = 0;
+  uint32_t rawRecords = 0;
+  uint64_t rawBytes = 0;
+  uint64_t storedBytes = 0;
+  uint64_t encodeCycles = 0;
+  uint64_t decodeCycles = 0;
+  size_t length = 0;
+  uint8_t stored[BatchRecord::capacity()];
+  sample_t sample = {0};
+  sample_t decoded = {0};
+  BatchRecord record;
+  BatchRecord readBack;
+
+  if (records == 0) {
+    shell_error(shell, "At least one record is needed");
+    return -EINVAL;
+  }
+
+  shell_print(shell, "%u records of %u samples per series", records, BATCH_RECORD_MAX_SAMPLES);
+
+  for (uint32_t series = 0; series < STORAGE_CODEC_SERIES_COUNT; series++) {
+    samples = 0;
+    rawRecords = 0;
+    rawBytes = 0;
+    storedBytes = 0;
+    encodeCycles = 0;
+    decodeCycles = 0;
+    sample = {.centiDegrees = 2150, .uptimeMs = UINT32_MAX - 60000, .status = SAMPLE_STATUS_OK};
+
+    for (uint32_t index = 0; index < records; index++) {
+      record.begin(index);
+      while (!record.isFull()) {
+        sample = codecSample((storage_codec_series_t)series, sample, samples + record.count(), &seed);
+        record.append(sample);
+      }
+
+      start = k_cycle_get_32();
+      length = record.encode(stored, sizeof(stored));
+      encodeCycles += k_cycle_get_32() - start;
+
+      start = k_cycle_get_32();
+      ret = (length > 0) ? readBack.decode(stored, length) : -ENOSPC;
+      decodeCycles += k_cycle_get_32() - start;
+
+      if ((ret < 0) || (readBack.sequence() != index) || (readBack.count() != record.count())) {
+        shell_error(shell, "%s: record %u didn't survive the round trip: %d",
+                    STORAGE_CODEC_SERIES_NAMES[series], index, ret);
+        return (ret < 0) ? ret : -EIO;
+      }
+
+      // Byte exact, sample by sample
+      record.rewind();
+      while (record.next(&sample) && readBack.next(&decoded)) {
+        if ((sample.centiDegrees != decoded.centiDegrees) ||
+            (sample.uptimeMs != decoded.uptimeMs) ||
+            (sample.status != decoded.status)) {
+          shell_error(shell, "%s: record %u, sample %u: %d at %u ms (%u) came back as %d at %u ms (%u)",
+                      STORAGE_CODEC_SERIES_NAMES[series], index, record.count() - record.remaining() - 1,
+                      sample.centiDegrees, sample.uptimeMs, sample.status,
+                      decoded.centiDegrees, decoded.uptimeMs, decoded.status);
+          return -EIO;
+        }
+      }
+
+      if (stored[offsetof(batch_record_header_t, encoding)] == BATCH_RECORD_ENCODING_RAW) {
+        rawRecords++;
+      }
+      samples += record.count();
+      rawBytes += record.size();
+      storedBytes += length;
+    }
+
+    shell_print(shell, "%s: %u.%u bits per sample, ratio %u.%02u:1, %u raw fallbacks, "
+                "encode %u samples/s, decode %u samples/s",
+                STORAGE_CODEC_SERIES_NAMES[series],
+                (uint32_t)((storedBytes * 8) / samples), (uint32_t)(((storedBytes * 80) / samples) % 10),
+                (uint32_t)(rawBytes / storedBytes), (uint32_t)(((rawBytes * 100) / storedBytes) % 100),
+                rawRecords,
+                perSecond(samples, k_cyc_to_us_floor64(encodeCycles)),
+                perSecond(samples, k_cyc_to_us_floor64(decodeCycles)));
+  }
+
+  return 0;
+}
+
+static int storageSyncCommand(const struct shell *shell, size_t argc, char **argv) {
+  int ret = Storage::getInstance().sync();
+
+  if (ret < 0) {
+    shell_error(shell, "Failed to flush the storage cache: %d", ret);
+    return ret;
+  }
+  shell_print(shell, "%d entries flushed", ret);
+
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(storageCommands,
+  SHELL_CMD(stats, NULL, "Show storage cache counters", storageStatsCommand),
+  SHELL_CMD(sync, NULL, "Flush the storage cache to flash", storageSyncCommand),
+  SHELL_CMD_ARG(bench, NULL,
+                "Benchmark a backend: bench <ram|nvs> [sectors] [record size] [records]",
+                storageBenchCommand, 2, 3),
+  SHELL_CMD_ARG(codec, NULL,
+                "Check and benchmark record compression: codec [records]",
+                storageCodecCommand, 1, 1),
+  SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(storage, &storageCommands, "Storage commands", NULL);
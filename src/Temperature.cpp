@@ -1,4 +1,8 @@
+// Lib C includes
+#include <errno.h>
+
 // Zephyr includes
+#include <zephyr/kernel.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/logging/log.h>
@@ -8,13 +12,13 @@ LOG_MODULE_REGISTER(Temperature);
 #include "Temperature.h"
 
 Temperature::Temperature(const struct device *device) {
+  this->_device = device;
+
   if (device == NULL) {
     LOG_ERR("Error: Invalid argument\r\n");
     return;
   }
 
-  this->_device = device;
-
   if (!device_is_ready(this->_device)) {
     LOG_ERR("Error: Device is not ready\r\n");
     return;
@@ -29,6 +33,11 @@ double Temperature::read() {
   int ret = 0;
   struct sensor_value value = {0};
 
+  // Boards without a die temperature sensor, such as native_sim
+  if (this->_device == NULL) {
+    return 0;
+  }
+
   ret = sensor_sample_fetch(this->_device);
   if (ret) {
       LOG_ERR("Failed to fetch sample (%d)\n", ret);
@@ -43,3 +52,42 @@ double Temperature::read() {
 
   return sensor_value_to_double(&value);
 }
+
+int Temperature::read(sample_t *sample) {
+  int ret = 0;
+  int32_t centiDegrees = 0;
+  struct sensor_value value = {0};
+
+  sample->centiDegrees = 0;
+  sample->uptimeMs = k_uptime_get_32();
+  sample->status = SAMPLE_STATUS_OK;
+
+  if (this->_device == NULL) {
+    sample->status = SAMPLE_STATUS_READ_ERROR;
+    return -ENODEV;
+  }
+
+  ret = sensor_sample_fetch(this->_device);
+  if (ret) {
+      LOG_ERR("Failed to fetch sample (%d)\n", ret);
+      sample->status = SAMPLE_STATUS_READ_ERROR;
+      return ret;
+  }
+
+  ret = sensor_channel_get(this->_device, SENSOR_CHAN_DIE_TEMP, &value);
+  if (ret) {
+      LOG_ERR("Failed to get data (%d)\n", ret);
+      sample->status = SAMPLE_STATUS_READ_ERROR;
+      return ret;
+  }
+
+  // val2 holds the millionths of a degree, with the same sign as val1
+  centiDegrees = (value.val1 * 100) + (value.val2 / 10000);
+  if ((centiDegrees > INT16_MAX) || (centiDegrees < INT16_MIN)) {
+    centiDegrees = (centiDegrees > INT16_MAX) ? INT16_MAX : INT16_MIN;
+    sample->status = SAMPLE_STATUS_OUT_OF_RANGE;
+  }
+  sample->centiDegrees = (int16_t)centiDegrees;
+
+  return 0;
+}
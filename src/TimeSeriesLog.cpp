@@ -0,0 +1,201 @@
+// Lib C includes
+#include <errno.h>
+
+// Zephyr includes
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(TimeSeriesLog);
+
+// User C++ class headers
+#include "TimeSeriesLog.h"
+#include "Storage.h"
+
+TimeSeriesLog::TimeSeriesLog(uint16_t firstId, uint16_t capacity, uint16_t metaId) {
+  this->firstId = firstId;
+  this->capacity = capacity;
+  this->metaId = metaId;
+
+  k_mutex_init(&this->mutex);
+  this->opened = false;
+
+  this->meta.head = 0;
+  this->meta.tail = 0;
+  this->readCursor = 0;
+  this->overwrittenCount = 0;
+}
+
+TimeSeriesLog::~TimeSeriesLog() {
+  // Destructor is automatically called when the object goes out of scope or is explicitly deleted
+}
+
+int TimeSeriesLog::append(BatchRecord &record) {
+  int ret = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  ret = this->open();
+  if (ret < 0) {
+    k_mutex_unlock(&this->mutex);
+    return ret;
+  }
+
+  // Full: the oldest record is about to be overwritten, even if it was never acknowledged
+  if ((this->meta.head - this->meta.tail) >= this->capacity) {
+    LOG_WRN("Time series log is full, record %d is lost\r\n", this->meta.tail);
+    this->meta.tail++;
+    this->overwrittenCount++;
+    if ((int32_t)(this->readCursor - this->meta.tail) < 0) {
+      this->readCursor = this->meta.tail;
+    }
+  }
+
+  // The record first, then the pointers, a record without its pointer is recovered by open(). Both skip
+  // the write-back cache, a record must be on flash once append() says so.
+  record.begin(this->meta.head);
+  ret = Storage::getInstance().writeBatch(this->idOf(this->meta.head), record, true);
+  if (ret == 0) {
+    this->meta.head++;
+    ret = this->persist();
+  }
+
+  k_mutex_unlock(&this->mutex);
+
+  return ret;
+}
+
+int TimeSeriesLog::next(BatchRecord *record) {
+  int ret = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  ret = this->open();
+  if (ret < 0) {
+    k_mutex_unlock(&this->mutex);
+    return ret;
+  }
+
+  ret = -ENOENT;
+  while (this->readCursor != this->meta.head) {
+    ret = Storage::getInstance().readBatch(this->idOf(this->readCursor), record);
+    this->readCursor++;
+
+    // The sequence in the record tells an overwritten or stale entry apart from the expected one
+    if ((ret == 0) && (record->sequence() == (this->readCursor - 1))) {
+      break;
+    }
+    LOG_ERR("Record %d of the time series log is unreadable, skipping it\r\n", this->readCursor - 1);
+    ret = -ENOENT;
+  }
+
+  k_mutex_unlock(&this->mutex);
+
+  return ret;
+}
+
+int TimeSeriesLog::ack(uint32_t sequence) {
+  int ret = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+
+  ret = this->open();
+  if (ret < 0) {
+    k_mutex_unlock(&this->mutex);
+    return ret;
+  }
+
+  // Only records that were handed out can be acknowledged, older ones may have been overwritten already
+  if (((int32_t)(sequence - this->meta.tail) >= 0) && ((int32_t)(sequence - this->readCursor) < 0)) {
+    this->meta.tail = sequence + 1;
+    ret = this->persist();
+  }
+
+  k_mutex_unlock(&this->mutex);
+
+  return ret;
+}
+
+void TimeSeriesLog::rewind() {
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  this->readCursor = this->meta.tail;
+  k_mutex_unlock(&this->mutex);
+}
+
+uint32_t TimeSeriesLog::pending() {
+  uint32_t pending = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  if (this->open() == 0) {
+    pending = this->meta.head - this->meta.tail;
+  }
+  k_mutex_unlock(&this->mutex);
+
+  return pending;
+}
+
+uint32_t TimeSeriesLog::unread() {
+  uint32_t unread = 0;
+
+  k_mutex_lock(&this->mutex, K_FOREVER);
+  if (this->open() == 0) {
+    unread = this->meta.head - this->readCursor;
+  }
+  k_mutex_unlock(&this->mutex);
+
+  return unread;
+}
+
+uint32_t TimeSeriesLog::overwritten() const {
+  return this->overwrittenCount;
+}
+
+int TimeSeriesLog::open() {
+  int ret = 0;
+  BatchRecord record;
+
+  // Opened on first use, the first read waits for the storage to be mounted
+  if (this->opened) {
+    return 0;
+  }
+
+  ret = Storage::getInstance().read(this->metaId, &this->meta, sizeof(this->meta));
+  if (ret == -ENOENT) {
+    LOG_INF("Starting a new time series log at id %d\r\n", this->firstId);
+    this->meta.head = 0;
+    this->meta.tail = 0;
+  } else if (ret != sizeof(this->meta)) {
+    LOG_ERR("Failed to read time series log pointers: %d\r\n", ret);
+    return (ret < 0) ? ret : -EBADMSG;
+  }
+
+  // Records appended right before a reset may not have their pointer persisted yet
+  for (uint16_t count = 0; count < this->capacity; count++) {
+    if ((Storage::getInstance().readBatch(this->idOf(this->meta.head), &record) != 0) ||
+        (record.sequence() != this->meta.head)) {
+      break;
+    }
+    this->meta.head++;
+  }
+
+  if ((this->meta.head - this->meta.tail) > this->capacity) {
+    this->meta.tail = this->meta.head - this->capacity;
+  }
+  this->readCursor = this->meta.tail;
+  this->opened = true;
+
+  LOG_INF("Time series log opened with records %d to %d pending\r\n", this->meta.tail, this->meta.head);
+
+  return 0;
+}
+
+int TimeSeriesLog::persist() {
+  int ret = 0;
+
+  // Written through, an acknowledged record must not come back after a reset
+  ret = Storage::getInstance().write(this->metaId, &this->meta, sizeof(this->meta), true);
+
+  return (ret < 0) ? ret : 0;
+}
+
+uint16_t TimeSeriesLog::idOf(uint32_t sequence) const {
+  return this->firstId + (sequence % this->capacity);
+}
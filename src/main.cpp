@@ -30,7 +30,7 @@ int main(void) {
     LOG_INF("Got IP address: %s\r\n", ipAddress);
 
     // Publish the event
-    zbus_chan_pub(&eventsChannel, &event, K_NO_WAIT);
+    eventPublish(event, K_MSEC(EVENT_PUBLISH_TIMEOUT_MS));
   });
 
   // Start the network and wait for an IP address